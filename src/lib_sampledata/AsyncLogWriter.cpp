@@ -0,0 +1,187 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: AsyncLogWriter.cpp                                   */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <chrono>
+#include "AsyncLogWriter.h"
+
+using namespace std;
+
+//---------------------------------------------------------
+// Procedure: LogAppendValue, LogAppendRow
+
+void LogAppendValue(string &record, int value, const char *sep)
+{
+  char buf[32];
+  int len = snprintf(buf, sizeof(buf), "%d%s", value, sep);
+  record.append(buf, len);
+}
+
+void LogAppendValue(string &record, double value, const char *sep)
+{
+  char buf[48];
+  int len = snprintf(buf, sizeof(buf), "%g%s", value, sep);
+  record.append(buf, len);
+}
+
+void LogAppendRow(string &record, const int *row, int count)
+{
+  for(int n = 0; n < count; n++)
+    LogAppendValue(record, row[n], (n == count - 1) ? "\n" : ",");
+}
+
+//---------------------------------------------------------
+// Constructor
+
+AsyncLogWriter::AsyncLogWriter(size_t capacity, int flush_ms)
+{
+  m_capacity = (capacity < 1) ? 1 : capacity;
+  m_flush_ms = flush_ms;
+  m_running  = false;
+  m_stop     = false;
+  m_ring.resize(m_capacity);
+  m_head     = 0;
+  m_count    = 0;
+  m_dropped  = 0;
+}
+
+//---------------------------------------------------------
+// Destructor
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+  Stop();
+
+  // Records queued while the writer wasn't running, before Start() or
+  // after Stop()
+  for(size_t k = 0; k < m_count; k++) {
+    Record &rec = m_ring[(m_head + k) % m_capacity];
+    fwrite(rec.text.data(), 1, rec.text.size(), m_files[rec.file]);
+  }
+  m_count = 0;
+  for(unsigned int f = 0; f < m_files.size(); f++)
+    if(m_files[f])
+      fclose(m_files[f]);
+}
+
+//---------------------------------------------------------
+// Procedure: Open
+
+int AsyncLogWriter::Open(const string &path)
+{
+  FILE *fp = fopen(path.c_str(), "a");
+  if(!fp)
+    return(-1);
+  setvbuf(fp, NULL, _IOFBF, 1 << 16);   // flushed by Run(), not by each record
+
+  lock_guard<mutex> lock(m_mutex);
+  m_files.push_back(fp);
+  return(m_files.size() - 1);
+}
+
+//---------------------------------------------------------
+// Procedure: Start
+
+void AsyncLogWriter::Start()
+{
+  if(m_running)
+    return;
+  m_stop    = false;
+  m_running = true;
+  m_thread  = thread(&AsyncLogWriter::Run, this);
+}
+
+//---------------------------------------------------------
+// Procedure: Stop
+
+void AsyncLogWriter::Stop()
+{
+  if(!m_running)
+    return;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+  m_running = false;
+}
+
+//---------------------------------------------------------
+// Procedure: Write
+
+bool AsyncLogWriter::Write(int file, const char *data, size_t len)
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if(file < 0 || file >= (int)m_files.size())
+      return(false);
+    if(m_count == m_capacity) {
+      m_dropped++;
+      return(false);
+    }
+    Record &rec = m_ring[(m_head + m_count) % m_capacity];
+    rec.file = file;
+    rec.text.assign(data, len);
+    m_count++;
+  }
+  m_cv.notify_one();
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Dropped
+
+unsigned long AsyncLogWriter::Dropped() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_dropped);
+}
+
+//---------------------------------------------------------
+// Procedure: Run
+//   Notes: takes every queued record at once, swapping the
+//          strings so both sides keep their buffers, and writes
+//          them with the lock released
+
+void AsyncLogWriter::Run()
+{
+  vector<Record> batch(m_capacity);
+  vector<FILE*> files;
+  chrono::steady_clock::time_point next_flush =
+    chrono::steady_clock::now() + chrono::milliseconds(m_flush_ms);
+
+  unique_lock<mutex> lock(m_mutex);
+  while(true) {
+    m_cv.wait_until(lock, next_flush, [this]{return(m_stop || m_count > 0);});
+    bool stopping = m_stop;
+
+    size_t n = m_count;
+    for(size_t k = 0; k < n; k++) {
+      Record &rec = m_ring[(m_head + k) % m_capacity];
+      batch[k].file = rec.file;
+      batch[k].text.swap(rec.text);
+    }
+    m_head = (m_head + n) % m_capacity;
+    m_count = 0;
+    if(files.size() != m_files.size())   // a file was opened since the last batch
+      files = m_files;
+    lock.unlock();
+
+    for(size_t k = 0; k < n; k++)
+      fwrite(batch[k].text.data(), 1, batch[k].text.size(), files[batch[k].file]);
+
+    if(stopping || chrono::steady_clock::now() >= next_flush) {
+      for(unsigned int f = 0; f < files.size(); f++)
+        fflush(files[f]);
+      next_flush = chrono::steady_clock::now() + chrono::milliseconds(m_flush_ms);
+    }
+
+    lock.lock();
+    if(stopping && m_count == 0)
+      break;
+  }
+}
@@ -0,0 +1,82 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: AsyncLogWriter.h                                     */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Writes log records to files from a background thread, so an app's
+// Iterate() never waits on the filesystem. Files are opened once and kept
+// open, records go through a bounded queue and are written in batches with
+// one flush every flush_ms. When the queue is full a record is dropped
+// (and counted) rather than stalling the caller.
+//
+// The queue slots keep their string buffers, so once every slot has held
+// a record as long as the ones being written nothing is allocated per
+// record.
+
+#ifndef AsyncLogWriter_HEADER
+#define AsyncLogWriter_HEADER
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+// Append a value and then sep to a record without going through a stream,
+// doubles the way ostream's defaults print them. LogAppendRow writes count
+// values separated by commas and ends the line
+void LogAppendValue(std::string &record, int value, const char *sep);
+void LogAppendValue(std::string &record, double value, const char *sep);
+void LogAppendRow(std::string &record, const int *row, int count);
+
+class AsyncLogWriter
+{
+ public:
+   AsyncLogWriter(size_t capacity = 1024, int flush_ms = 500);
+   ~AsyncLogWriter();
+
+   // Opens path for appending, returns the file's id for Write() or -1
+   int  Open(const std::string &path);
+
+   // Starts the writer thread, Stop() writes out the queue and flushes. The
+   // files stay open until the writer is destroyed. Records written while
+   // the thread isn't running wait in the queue for the next Start() or
+   // the destructor
+   void Start();
+   void Stop();
+
+   // Queues len bytes for file, false if the record was dropped
+   bool Write(int file, const char *data, size_t len);
+   bool Write(int file, const std::string &text) {return(Write(file, text.data(), text.size()));}
+
+   unsigned long Dropped() const;
+
+ protected:
+   struct Record
+   {
+     int         file;
+     std::string text;
+   };
+   void Run();
+
+ protected:
+   size_t m_capacity;
+   int    m_flush_ms;
+   bool   m_running;
+   bool   m_stop;
+
+   mutable std::mutex      m_mutex;   // guards everything below
+   std::condition_variable m_cv;
+   std::thread             m_thread;
+
+   std::vector<FILE*>  m_files;
+   std::vector<Record> m_ring;
+   size_t              m_head;        // oldest queued record
+   size_t              m_count;
+   unsigned long       m_dropped;
+};
+
+#endif
@@ -0,0 +1,152 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: NoiseSource.cpp                                      */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include "NoiseSource.h"
+
+using namespace std;
+
+//---------------------------------------------------------
+// Procedure: NoiseModeFromName
+
+int NoiseModeFromName(const string &name)
+{
+  if(name == "live")
+    return(NOISE_LIVE);
+  if(name == "record")
+    return(NOISE_RECORD);
+  if(name == "replay")
+    return(NOISE_REPLAY);
+  return(-1);
+}
+
+//---------------------------------------------------------
+// Constructor
+
+NoiseSource::NoiseSource()
+{
+  m_mode   = NOISE_LIVE;
+  m_record = NULL;
+  m_next   = 0;
+  m_draws  = 0;
+  m_rejected = 0;
+  SetSeed(0);
+}
+
+//---------------------------------------------------------
+// Destructor
+
+NoiseSource::~NoiseSource()
+{
+  Close();
+}
+
+//---------------------------------------------------------
+// Procedure: SetSeed
+
+void NoiseSource::SetSeed(uint32_t seed)
+{
+  while(seed == 0)
+    seed = random_device()();
+  m_seed = seed;
+  m_rng.seed(seed);
+}
+
+//---------------------------------------------------------
+// Procedure: Open
+
+bool NoiseSource::Open(int mode, const string &path, string &err)
+{
+  Close();
+  if(mode == NOISE_RECORD) {
+    m_record = fopen(path.c_str(), "w");
+    if(!m_record) {
+      err = "can't write noise tape " + path + ": " + strerror(errno);
+      return(false);
+    }
+    fprintf(m_record, "# noise tape, seed %u\n", m_seed);
+  }
+  else if(mode == NOISE_REPLAY) {
+    FILE *fp = fopen(path.c_str(), "r");
+    if(!fp) {
+      err = "can't read noise tape " + path + ": " + strerror(errno);
+      return(false);
+    }
+    unsigned int seed = 0;
+    if(fscanf(fp, "# noise tape, seed %u", &seed) != 1) {
+      fclose(fp);
+      err = path + " is not a noise tape";
+      return(false);
+    }
+    m_tape.clear();
+    int value;
+    while(fscanf(fp, "%d", &value) == 1)
+      m_tape.push_back(value);
+    fclose(fp);
+    SetSeed(seed);
+  }
+  m_mode = mode;
+  m_next = 0;
+  m_draws = 0;
+  m_rejected = 0;
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Close
+
+void NoiseSource::Close()
+{
+  if(m_record)
+    fclose(m_record);
+  m_record = NULL;
+  m_tape.clear();
+  m_mode = NOISE_LIVE;
+}
+
+//---------------------------------------------------------
+// Procedure: Draw
+//   Notes: the generator draws while replaying too, see the
+//          top of NoiseSource.h
+
+int NoiseSource::Draw(int min, int max)
+{
+  m_draws++;
+  int value = Generate(min, max);
+  if(m_mode == NOISE_REPLAY && m_next < m_tape.size()) {
+    int taped = m_tape[m_next++];
+    if(taped >= min && taped <= max)
+      return(taped);
+    m_rejected++;
+    return(value);
+  }
+  if(m_record)
+    fprintf(m_record, "%d\n", value);
+  return(value);
+}
+
+//---------------------------------------------------------
+// Procedure: Generate
+//   Notes: rejects the top partial span of the generator's
+//          range, so every value in [min, max] is equally likely
+
+int NoiseSource::Generate(int min, int max)
+{
+  int value = min;
+  if(max > min) {
+    uint64_t span  = (uint64_t)max - min + 1;
+    uint64_t limit = ((uint64_t)1 << 32) - (((uint64_t)1 << 32) % span);
+    uint64_t r;
+    do {
+      r = m_rng();
+    } while(r >= limit);
+    value = min + (int)(r % span);
+  }
+  return(value);
+}
@@ -0,0 +1,84 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: NoiseSource.h                                        */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// The random noise the simulation apps add (the wiggle in
+// pIncludeSampleData, the range noise in pSimDistanceGenerator), made
+// repeatable so two runs can be compared.
+//
+// Draws come from an mt19937 with a known seed, mapped to their range
+// without std::uniform_int_distribution so the same seed gives the same
+// draws with any standard library. A seed of 0 picks one at random, and
+// Seed() says which, so a run can be repeated after the fact.
+//
+// Modes:
+//   live    draws from the generator
+//   record  the same, and writes every draw to a tape file
+//   replay  reads the draws back from a tape, whatever the code or seed
+//           is now. The generator, seeded with the tape's seed, draws
+//           alongside and its draws are dropped, so once the tape runs out
+//           they carry on where the recorded run would have. A tape value
+//           outside the range asked for (a tape recorded with other
+//           bounds, or edited) is rejected and the generator's draw used
+//
+// A tape is text, a "# noise tape, seed N" line and then one draw per line.
+
+#ifndef NoiseSource_HEADER
+#define NoiseSource_HEADER
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <random>
+#include <stdint.h>
+
+enum NoiseMode
+{
+  NOISE_LIVE   = 0,
+  NOISE_RECORD = 1,
+  NOISE_REPLAY = 2
+};
+
+// "live", "record" or "replay" to a NoiseMode, -1 if it isn't one of those
+int NoiseModeFromName(const std::string &name);
+
+class NoiseSource
+{
+ public:
+   NoiseSource();
+   ~NoiseSource();
+
+   void     SetSeed(uint32_t seed);
+   uint32_t Seed() const {return(m_seed);}
+
+   // Starts recording to or replaying from path, replay also takes the
+   // tape's seed. Not needed for live
+   bool Open(int mode, const std::string &path, std::string &err);
+   void Close();
+
+   // A draw from [min, max]
+   int  Draw(int min, int max);
+
+   int  Mode() const {return(m_mode);}
+   unsigned long Draws() const {return(m_draws);}
+   unsigned long Rejected() const {return(m_rejected);}
+   bool TapeEnded() const {return(m_mode == NOISE_REPLAY && m_next >= m_tape.size());}
+
+ protected:
+   int  Generate(int min, int max);
+
+ protected:
+   uint32_t     m_seed;
+   std::mt19937 m_rng;
+   int          m_mode;
+   FILE        *m_record;
+   std::vector<int> m_tape;
+   size_t       m_next;
+   unsigned long m_draws;
+   unsigned long m_rejected;   // tape values outside the range asked for
+};
+
+#endif
@@ -0,0 +1,390 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingFile.cpp                                         */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cmath>
+#include <png.h>
+#include <sys/stat.h>
+#include "PingFile.h"
+
+using namespace std;
+
+static_assert(sizeof(PingFileHeader) == 64, "the ping file header is 64 bytes on disk");
+
+//---------------------------------------------------------
+// Procedure: PingDTypeBytes
+
+size_t PingDTypeBytes(uint32_t dtype)
+{
+  switch(dtype) {
+  case PING_U8:  return(1);
+  case PING_U16: return(2);
+  case PING_I32: return(4);
+  case PING_F32: return(4);
+  }
+  return(0);
+}
+
+//---------------------------------------------------------
+// Procedure: PingDTypeFromName
+
+uint32_t PingDTypeFromName(const string &name)
+{
+  if(name == "u8")  return(PING_U8);
+  if(name == "u16") return(PING_U16);
+  if(name == "i32") return(PING_I32);
+  if(name == "f32") return(PING_F32);
+  return(0);
+}
+
+//---------------------------------------------------------
+// Procedure: PingSmallestDType
+
+uint32_t PingSmallestDType(const int *samples, size_t n)
+{
+  int lo = 0, hi = 0;
+  for(size_t i = 0; i < n; i++) {
+    if(samples[i] < lo) lo = samples[i];
+    if(samples[i] > hi) hi = samples[i];
+  }
+  if(lo >= 0 && hi <= UINT8_MAX)
+    return(PING_U8);
+  if(lo >= 0 && hi <= UINT16_MAX)
+    return(PING_U16);
+  return(PING_I32);
+}
+
+//---------------------------------------------------------
+// Procedure: PingIsBinary
+
+bool PingIsBinary(const string &path)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if(!fp)
+    return(false);
+  char magic[8];
+  bool binary = (fread(magic, 1, 8, fp) == 8) && (memcmp(magic, PING_FILE_MAGIC, 8) == 0);
+  fclose(fp);
+  return(binary);
+}
+
+//---------------------------------------------------------
+// Procedure: PingRead
+//   Notes: the samples are read in one block and widened in
+//          place, back to front so nothing is overwritten early
+
+bool PingRead(const string &path, vector<int> &samples,
+              PingFileHeader &hdr, string &err)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if(!fp) {
+    err = "can't open " + path;
+    return(false);
+  }
+
+  bool ok = (fread(&hdr, sizeof(hdr), 1, fp) == 1);
+  if(!ok || memcmp(hdr.magic, PING_FILE_MAGIC, 8) != 0) {
+    err = path + " is not a ping file";
+    fclose(fp);
+    return(false);
+  }
+  size_t bytes = PingDTypeBytes(hdr.dtype);
+  if(hdr.version != PING_FILE_VERSION || bytes == 0 || hdr.header_bytes < sizeof(hdr)) {
+    err = path + " is an unsupported ping file version or sample type";
+    fclose(fp);
+    return(false);
+  }
+
+  // rows and cols come from the file, check them against its size
+  // before allocating anything
+  size_t n = (size_t)hdr.rows * hdr.cols;
+  struct stat st;
+  if(fstat(fileno(fp), &st) != 0 || (uint64_t)st.st_size < hdr.header_bytes ||
+     (hdr.cols > 0 && hdr.rows > ((uint64_t)st.st_size - hdr.header_bytes) / bytes / hdr.cols)) {
+    err = path + " is shorter than its header says";
+    fclose(fp);
+    return(false);
+  }
+  samples.assign(n + 1, 0);   // + 1 so &samples[0] is valid for an empty file
+  char *raw = (char *)&samples[0];
+  ok = (fseek(fp, hdr.header_bytes, SEEK_SET) == 0) && (fread(raw, bytes, n, fp) == n);
+  fclose(fp);
+  if(!ok) {
+    err = path + " is shorter than its header says";
+    return(false);
+  }
+
+  for(size_t i = n; i-- > 0; ) {
+    switch(hdr.dtype) {
+    case PING_U8:  samples[i] = ((uint8_t *)raw)[i];  break;
+    case PING_U16: samples[i] = ((uint16_t *)raw)[i]; break;
+    case PING_I32: break;
+    case PING_F32: {
+      float f;
+      memcpy(&f, raw + i * 4, 4);
+      samples[i] = (int)lround(f);
+      break;
+    }
+    }
+  }
+  samples.resize(n);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: PingWrite
+
+bool PingWrite(const string &path, const int *samples, uint32_t rows,
+               uint32_t cols, uint32_t dtype, double range_scale,
+               double range_offset, string &err)
+{
+  size_t bytes = PingDTypeBytes(dtype);
+  if(bytes == 0) {
+    err = "unknown sample type";
+    return(false);
+  }
+  size_t n = (size_t)rows * cols;
+  if(dtype == PING_U8 || dtype == PING_U16) {
+    int hi = (dtype == PING_U8) ? UINT8_MAX : UINT16_MAX;
+    for(size_t i = 0; i < n; i++) {
+      if(samples[i] < 0 || samples[i] > hi) {
+        err = "sample " + to_string(samples[i]) + " doesn't fit in the sample type";
+        return(false);
+      }
+    }
+  }
+
+  PingFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PING_FILE_MAGIC, 8);
+  hdr.version      = PING_FILE_VERSION;
+  hdr.header_bytes = sizeof(hdr);
+  hdr.rows         = rows;
+  hdr.cols         = cols;
+  hdr.dtype        = dtype;
+  hdr.range_scale  = range_scale;
+  hdr.range_offset = range_offset;
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if(!fp) {
+    err = "can't write " + path;
+    return(false);
+  }
+  bool ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+
+  // One row at a time, narrowed into a buffer of the file's type
+  vector<char> row(cols * bytes + 1);
+  for(uint32_t r = 0; ok && r < rows; r++) {
+    const int *src = samples + (size_t)r * cols;
+    for(uint32_t c = 0; c < cols; c++) {
+      if(dtype == PING_U8) {
+        uint8_t v = src[c];
+        memcpy(&row[c], &v, 1);
+      }
+      else if(dtype == PING_U16) {
+        uint16_t v = src[c];
+        memcpy(&row[c * 2], &v, 2);
+      }
+      else if(dtype == PING_I32) {
+        int32_t v = src[c];
+        memcpy(&row[c * 4], &v, 4);
+      }
+      else {
+        float v = src[c];
+        memcpy(&row[c * 4], &v, 4);
+      }
+    }
+    ok = (cols == 0) || (fwrite(&row[0], bytes, cols, fp) == cols);
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok)
+    err = "error writing " + path;
+  return(ok);
+}
+
+//---------------------------------------------------------
+// Procedure: ReadLine
+//   Notes: reads one whole line, however long, false at EOF
+
+static bool ReadLine(FILE *fp, string &line)
+{
+  char buf[4096];
+  line.clear();
+  while(fgets(buf, sizeof(buf), fp)) {
+    line += buf;
+    if(line[line.size() - 1] == '\n')
+      break;
+  }
+  return(!line.empty());
+}
+
+//---------------------------------------------------------
+// Procedure: PingReadCsv
+
+bool PingReadCsv(const string &path, vector<int> &samples,
+                 uint32_t &rows, uint32_t &cols, string &err)
+{
+  FILE *fp = fopen(path.c_str(), "r");
+  if(!fp) {
+    err = "can't open " + path;
+    return(false);
+  }
+
+  samples.clear();
+  rows = 0;
+  cols = 0;
+  string line;
+  while(ReadLine(fp, line)) {
+    // The number of delimiters on the first line gives the number of columns
+    if(rows == 0) {
+      cols = 1;
+      for(size_t i = 0; i < line.size(); i++)
+        if(line[i] == ',')
+          cols++;
+    }
+
+    samples.resize(samples.size() + cols, 0);
+    int *row = &samples[(size_t)rows * cols];
+    const char *c = line.c_str();
+    for(uint32_t col = 0; col < cols; col++) {
+      char *end;
+      long value = strtol(c, &end, 10);
+      if(end == c)
+        break;
+      row[col] = value;
+      c = end;
+      while(*c == ',' || *c == ' ')
+        c++;
+    }
+    rows++;
+  }
+  fclose(fp);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: PingWriteCsv
+
+bool PingWriteCsv(const string &path, const int *samples, uint32_t rows,
+                  uint32_t cols, string &err)
+{
+  FILE *fp = fopen(path.c_str(), "w");
+  if(!fp) {
+    err = "can't write " + path;
+    return(false);
+  }
+  bool ok = true;
+  for(uint32_t r = 0; ok && r < rows; r++) {
+    const int *src = samples + (size_t)r * cols;
+    for(uint32_t c = 0; c < cols; c++)
+      fprintf(fp, (c + 1 < cols) ? "%d," : "%d", src[c]);
+    ok = (fprintf(fp, "\n") == 1);
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok)
+    err = "error writing " + path;
+  return(ok);
+}
+
+//---------------------------------------------------------
+// Procedure: PingIsPng
+
+bool PingIsPng(const string &path)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if(!fp)
+    return(false);
+  png_byte sig[8];
+  bool png = (fread(sig, 1, 8, fp) == 8) && (png_sig_cmp(sig, 0, 8) == 0);
+  fclose(fp);
+  return(png);
+}
+
+//---------------------------------------------------------
+// Procedure: PingReadPng
+//   Notes: decoded the way the image crate behind image_to_csv_rs
+//          does it, so a PNG gives the same samples as its
+//          converted csv did: palettes and low bit depths are
+//          expanded, 16 bit samples keep their high byte, alpha
+//          and gAMA are ignored, and each pixel is reduced to its
+//          float luma, truncated, even if it was gray already.
+//          The rows of pixels are then transposed so each ping's
+//          samples are contiguous
+
+bool PingReadPng(const string &path, vector<int> &samples,
+                 uint32_t &rows, uint32_t &cols, string &err)
+{
+  FILE *fp = fopen(path.c_str(), "rb");
+  if(!fp) {
+    err = "can't open " + path;
+    return(false);
+  }
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  vector<png_byte> pixels;
+  vector<png_bytep> lines;
+  if(!info || setjmp(png_jmpbuf(png))) {
+    err = "can't decode PNG " + path;
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(fp);
+    return(false);
+  }
+
+  png_init_io(png, fp);
+  png_read_info(png, info);
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_strip_alpha(png);
+  png_set_gray_to_rgb(png);
+  png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  rows = png_get_image_width(png, info);
+  cols = png_get_image_height(png, info);
+  size_t stride = png_get_rowbytes(png, info);
+  pixels.resize(stride * cols);
+  lines.resize(cols);
+  for(uint32_t y = 0; y < cols; y++)
+    lines[y] = &pixels[(size_t)y * stride];
+  png_read_image(png, &lines[0]);
+  png_read_end(png, NULL);
+  png_destroy_read_struct(&png, &info, NULL);
+  fclose(fp);
+
+  samples.resize((size_t)rows * cols);
+  for(uint32_t y = 0; y < cols; y++) {
+    const png_byte *line = lines[y];
+    for(uint32_t x = 0; x < rows; x++) {
+      const png_byte *px = line + x * 3;
+      samples[(size_t)x * cols + y] = (int)(0.2126f * px[0] + 0.7152f * px[1] + 0.0722f * px[2]);
+    }
+  }
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: PingReadImage
+
+bool PingReadImage(const string &path, vector<int> &samples,
+                   PingFileHeader &hdr, string &err)
+{
+  if(PingIsBinary(path))
+    return(PingRead(path, samples, hdr, err));
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, PING_FILE_MAGIC, 8);
+  hdr.version = PING_FILE_VERSION;
+  hdr.header_bytes = sizeof(hdr);
+  if(PingIsPng(path)) {
+    hdr.dtype = PING_U8;
+    return(PingReadPng(path, samples, hdr.rows, hdr.cols, err));
+  }
+  return(PingReadCsv(path, samples, hdr.rows, hdr.cols, err));
+}
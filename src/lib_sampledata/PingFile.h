@@ -0,0 +1,112 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingFile.h                                           */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Binary sonar ping files, the compact replacement for the csv image files
+// read by pIncludeSampleData. A ping file is one 64 byte header followed by
+// rows * cols samples, row-major, one row per ping and one column per range
+// bin. Everything is in host byte order, little endian on the supported
+// targets (checked below).
+//
+//   offset  size  field
+//        0     8  magic "SAMSPING"
+//        8     4  version (PING_FILE_VERSION)
+//       12     4  header_bytes (64, samples start here)
+//       16     4  rows, number of pings
+//       20     4  cols, samples per ping
+//       24     4  dtype, one of PingDType
+//       28     4  reserved, 0
+//       32     8  range_scale, meters per column (double)
+//       40     8  range_offset, meters at column 0 (double)
+//       48    16  reserved, 0
+
+#ifndef PingFile_HEADER
+#define PingFile_HEADER
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Files are read and written as the host's structs, with no byte swapping
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "ping files and streams are little endian, this host is not"
+#endif
+
+#define PING_FILE_MAGIC   "SAMSPING"
+#define PING_FILE_VERSION 1
+
+enum PingDType
+{
+  PING_U8  = 1,
+  PING_U16 = 2,
+  PING_I32 = 3,
+  PING_F32 = 4
+};
+
+struct PingFileHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_bytes;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t dtype;
+  uint32_t reserved0;
+  double   range_scale;
+  double   range_offset;
+  uint8_t  reserved1[16];
+};
+
+// Bytes per sample of dtype, 0 if it isn't a PingDType
+size_t PingDTypeBytes(uint32_t dtype);
+
+// "u8", "u16", "i32" or "f32" to a PingDType, 0 if it isn't one of those
+uint32_t PingDTypeFromName(const std::string &name);
+
+// Smallest integer dtype that holds every one of the n samples exactly
+uint32_t PingSmallestDType(const int *samples, size_t n);
+
+// True if the file starts with PING_FILE_MAGIC
+bool PingIsBinary(const std::string &path);
+
+// Reads a ping file into samples (rows * cols values, converted to int) and
+// hdr. Returns false and sets err if the file is missing, truncated or not
+// a ping file
+bool PingRead(const std::string &path, std::vector<int> &samples,
+              PingFileHeader &hdr, std::string &err);
+
+// Writes rows * cols samples as dtype. Returns false and sets err if the
+// file can't be written or a sample doesn't fit in dtype
+bool PingWrite(const std::string &path, const int *samples, uint32_t rows,
+               uint32_t cols, uint32_t dtype, double range_scale,
+               double range_offset, std::string &err);
+
+// Reads a csv image, one ping per line, as written by image_to_csv_rs. The
+// column count comes from the first line, shorter rows are padded with
+// zeros and longer ones cut off
+bool PingReadCsv(const std::string &path, std::vector<int> &samples,
+                 uint32_t &rows, uint32_t &cols, std::string &err);
+
+// Writes rows * cols samples as a csv image
+bool PingWriteCsv(const std::string &path, const int *samples, uint32_t rows,
+                  uint32_t cols, std::string &err);
+
+// True if the file starts with the PNG signature
+bool PingIsPng(const std::string &path);
+
+// Reads a PNG sonar image as 8 bit luma, the same samples image_to_csv_rs
+// gives (no gamma correction). As with image_to_csv_rs each column of
+// pixels is one ping, top row first
+bool PingReadPng(const std::string &path, std::vector<int> &samples,
+                 uint32_t &rows, uint32_t &cols, std::string &err);
+
+// Reads a ping file, PNG or csv image, whichever path is. hdr gets rows,
+// cols and the dtype for all three (0 for csv), the range scale only comes
+// from a ping file and is 0 otherwise
+bool PingReadImage(const std::string &path, std::vector<int> &samples,
+                   PingFileHeader &hdr, std::string &err);
+
+#endif
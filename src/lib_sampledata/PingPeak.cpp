@@ -0,0 +1,137 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingPeak.cpp                                         */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <algorithm>
+#include "PingPeak.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+using namespace std;
+
+//---------------------------------------------------------
+// Procedure: PingRefineFromName
+
+int PingRefineFromName(const string &name)
+{
+  if(name == "none")      return(PING_REFINE_NONE);
+  if(name == "parabolic") return(PING_REFINE_PARABOLIC);
+  if(name == "centroid")  return(PING_REFINE_CENTROID);
+  return(-1);
+}
+
+//---------------------------------------------------------
+// Procedure: PingArgMax
+//   Notes: two passes, the largest value four columns at a time
+//          and then the first column holding it. Both are
+//          branch free over the window, which beats the single
+//          compare-and-branch loop on the short windows we use
+
+int PingArgMax(const int *samples, int begin, int end)
+{
+  if(end <= begin)
+    return(-1);
+
+  int i = begin;
+  int best = samples[begin];
+#if defined(__SSE2__)
+  if(end - begin >= 8) {
+    __m128i vbest = _mm_loadu_si128((const __m128i *)(samples + begin));
+    for(i = begin + 4; i + 4 <= end; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+#if defined(__SSE4_1__)
+      vbest = _mm_max_epi32(vbest, v);
+#else
+      __m128i gt = _mm_cmpgt_epi32(v, vbest);
+      vbest = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vbest));
+#endif
+    }
+    int lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, vbest);
+    best = max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3]));
+  }
+#endif
+  for(; i < end; i++)
+    best = max(best, samples[i]);
+
+  i = begin;
+#if defined(__SSE2__)
+  __m128i vbest = _mm_set1_epi32(best);
+  for(; i + 4 <= end; i += 4) {
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(samples + i)), vbest);
+    if(_mm_movemask_epi8(eq) != 0)
+      break;
+  }
+#endif
+  while(samples[i] != best)
+    i++;
+  return(i);
+}
+
+//---------------------------------------------------------
+// Procedure: PingRefinePeak
+
+double PingRefinePeak(const int *samples, int begin, int end, int index,
+                      int refine, int half_width)
+{
+  if(refine == PING_REFINE_PARABOLIC) {
+    // Needs a neighbour on each side, a peak on the window edge stays put
+    if(index - 1 < begin || index + 1 >= end)
+      return(index);
+    double left  = samples[index - 1];
+    double mid   = samples[index];
+    double right = samples[index + 1];
+    double denom = left - 2 * mid + right;
+    if(denom >= 0)   // flat or not a maximum
+      return(index);
+    double offset = 0.5 * (left - right) / denom;
+    return(index + max(-0.5, min(0.5, offset)));
+  }
+
+  if(refine == PING_REFINE_CENTROID) {
+    int lo = max(begin, index - half_width);
+    int hi = min(end - 1, index + half_width);
+    // Weights are the height above the lowest sample used, so a constant
+    // background doesn't pull the centroid toward the middle of the window
+    int floor_value = samples[lo];
+    for(int j = lo; j <= hi; j++)
+      floor_value = min(floor_value, samples[j]);
+    double sum = 0, moment = 0;
+    for(int j = lo; j <= hi; j++) {
+      double w = samples[j] - floor_value;
+      sum += w;
+      moment += w * j;
+    }
+    if(sum <= 0)
+      return(index);
+    return(moment / sum);
+  }
+
+  return(index);
+}
+
+//---------------------------------------------------------
+// Procedure: PingFindPeak
+
+PingPeak PingFindPeak(const int *samples, int n, int begin, int end,
+                      int refine, int half_width)
+{
+  begin = max(begin, 0);
+  end = min(end, n);
+
+  PingPeak peak;
+  peak.index = PingArgMax(samples, begin, end);
+  peak.value = (peak.index >= 0) ? samples[peak.index] : 0;
+  peak.position = peak.index;
+  if(peak.index >= 0)
+    peak.position = PingRefinePeak(samples, begin, end, peak.index, refine, half_width);
+  return(peak);
+}
@@ -0,0 +1,47 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingPeak.h                                           */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Finds the strongest return of a ping, the column the bottom or target
+// shows up in. The search runs over a window of columns, with SSE when the
+// compiler targets it, and the peak can be refined to a fraction of a
+// column from its neighbours so distances aren't quantized to range bins.
+
+#ifndef PingPeak_HEADER
+#define PingPeak_HEADER
+
+#include <string>
+
+enum PingRefine
+{
+  PING_REFINE_NONE      = 0,
+  PING_REFINE_PARABOLIC = 1,  // vertex of the parabola through the peak and its two neighbours
+  PING_REFINE_CENTROID  = 2   // amplitude weighted mean column around the peak
+};
+
+struct PingPeak
+{
+  int    index;     // column of the largest sample, the first one if there are ties, -1 if none
+  int    value;     // the largest sample
+  double position;  // refined column, index if not refined
+};
+
+// "none", "parabolic" or "centroid" to a PingRefine, -1 if it isn't one of those
+int PingRefineFromName(const std::string &name);
+
+// First column of the largest sample in [begin, end), -1 if the window is empty
+int PingArgMax(const int *samples, int begin, int end);
+
+// Refines the peak at index using the samples in [begin, end). half_width is
+// how many columns either side of the peak the centroid uses
+double PingRefinePeak(const int *samples, int begin, int end, int index,
+                      int refine, int half_width = 2);
+
+// Finds and refines the peak of the window [begin, end), clipped to [0, n)
+PingPeak PingFindPeak(const int *samples, int n, int begin, int end,
+                      int refine, int half_width = 2);
+
+#endif
@@ -0,0 +1,357 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingPipeline.cpp                                     */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstring>
+#include "PingPipeline.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//---------------------------------------------------------
+// Constructor
+
+PingPipeline::PingPipeline()
+{
+  m_image        = NULL;
+  m_rows         = 0;
+  m_cols         = 0;
+  m_stream       = NULL;
+  m_log          = NULL;
+  m_log_raw      = -1;
+  m_log_padded   = -1;
+  m_log_maximums = -1;
+  m_telemetry    = NULL;
+  m_running      = false;
+  m_stop         = false;
+  m_requested    = 0;
+  m_next_row     = 0;
+  m_wakes        = 0;
+  m_latest.seq   = 0;
+  m_count        = 0;
+  for(int s = 0; s < PIPE_STAGES; s++)
+    m_sum_ms[s] = m_max_ms[s] = 0;
+}
+
+//---------------------------------------------------------
+// Destructor
+
+PingPipeline::~PingPipeline()
+{
+  Stop();
+}
+
+//---------------------------------------------------------
+// Procedure: SetImage, SetStream, SetLogs
+
+void PingPipeline::SetImage(const int *image, int rows, int cols)
+{
+  m_image  = image;
+  m_rows   = rows;
+  m_cols   = cols;
+  m_stream = NULL;
+  m_request_at.assign(rows > 0 ? rows : 0, Clock::time_point());
+}
+
+void PingPipeline::SetStream(PingStream *stream)
+{
+  m_stream = stream;
+  m_image  = NULL;
+}
+
+void PingPipeline::SetLogs(AsyncLogWriter *log, int raw, int padded, int maximums)
+{
+  m_log          = log;
+  m_log_raw      = raw;
+  m_log_padded   = padded;
+  m_log_maximums = maximums;
+}
+
+//---------------------------------------------------------
+// Procedure: Start
+
+void PingPipeline::Start(int frames)
+{
+  if(m_running)
+    return;
+  if(frames < 2)
+    frames = 2;
+
+  int max_cols = m_processor.MaxCols();
+  m_frames.resize(frames);
+  for(int f = 0; f < frames; f++) {
+    m_frames[f].samples.assign(max_cols, 0);
+    m_frames[f].padded.assign(m_processor.PaddedCapacity(), 0);
+    m_frames[f].cols = 0;
+    m_frames[f].padded_size = 0;
+  }
+  m_free.Reset(frames);
+  m_decoded.Reset(frames);
+  m_analyzed.Reset(frames);
+  for(int f = 0; f < frames; f++)
+    m_free.Push(f);
+
+  m_requested = 0;
+  m_next_row  = 0;
+  m_latest.seq = 0;
+  m_stop      = false;
+  m_running   = true;
+  if(m_stream)
+    m_stream->SetNotify(WakeStream, this);
+  m_threads[0] = thread(&PingPipeline::Decode, this);
+  m_threads[1] = thread(&PingPipeline::Analyze, this);
+  m_threads[2] = thread(&PingPipeline::Log, this);
+}
+
+//---------------------------------------------------------
+// Procedure: Stop
+
+void PingPipeline::Stop()
+{
+  if(!m_running)
+    return;
+  m_stop = true;
+  Wake();
+  for(int t = 0; t < 3; t++)
+    m_threads[t].join();
+  if(m_stream)
+    m_stream->SetNotify(NULL, NULL);
+  m_running = false;
+}
+
+//---------------------------------------------------------
+// Procedure: RequestRow
+
+bool PingPipeline::RequestRow()
+{
+  if(!m_image || m_requested >= m_rows)
+    return(false);
+  m_request_at[m_requested] = Clock::now();
+  m_requested++;
+  Wake();
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: WaitForRow
+//   Notes: rows are analysed in order, so row n's detection is
+//          the one with seq n
+
+bool PingPipeline::WaitForRow(PingDetection &det, double timeout)
+{
+  unsigned long row = m_requested;
+  unique_lock<mutex> lock(m_mutex);
+  if(row == 0 || !m_latest_changed.wait_for(lock, chrono::duration<double>(timeout),
+                                            [&]{return(m_latest.seq >= row);}))
+    return(false);
+  det = m_latest;
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Latest
+
+bool PingPipeline::Latest(PingDetection &det) const
+{
+  lock_guard<mutex> lock(m_mutex);
+  if(m_latest.seq == 0)
+    return(false);
+  det = m_latest;
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Latency
+
+void PingPipeline::Latency(PipelineLatency latency[PIPE_STAGES], bool reset)
+{
+  lock_guard<mutex> lock(m_mutex);
+  for(int s = 0; s < PIPE_STAGES; s++) {
+    latency[s].count   = m_count;
+    latency[s].mean_ms = (m_count > 0) ? m_sum_ms[s] / m_count : 0;
+    latency[s].max_ms  = m_max_ms[s];
+    if(reset)
+      m_sum_ms[s] = m_max_ms[s] = 0;
+  }
+  if(reset)
+    m_count = 0;
+}
+
+//---------------------------------------------------------
+// Procedure: Idle, Wake, WakeStream
+//   Notes: a thread reads m_wakes before looking at its queue
+//          and sleeps until it changes, so a push in between is
+//          never missed. Idle is false once stopping
+
+bool PingPipeline::Idle(unsigned long seen)
+{
+  unique_lock<mutex> lock(m_wake_mutex);
+  m_wake.wait(lock, [&]{return(m_stop || m_wakes != seen);});
+  return(!m_stop);
+}
+
+void PingPipeline::Wake()
+{
+  {
+    lock_guard<mutex> lock(m_wake_mutex);
+    m_wakes++;
+  }
+  m_wake.notify_all();
+}
+
+void PingPipeline::WakeStream(void *pipeline)
+{
+  ((PingPipeline *)pipeline)->Wake();
+}
+
+//---------------------------------------------------------
+// Procedure: TakePing
+//   Notes: the next ping into frame if there is one
+
+bool PingPipeline::TakePing(Frame &frame)
+{
+  if(m_stream) {
+    int cols = 0;
+    if(!m_stream->TakeNewest(&frame.samples[0], cols, &frame.stamp[0]))
+      return(false);
+    frame.cols = cols;
+    return(true);
+  }
+  if(!m_image || m_next_row >= m_requested || m_cols > (int)frame.samples.size())
+    return(false);
+  frame.cols = m_cols;
+  frame.stamp[0] = m_request_at[m_next_row];
+  memcpy(&frame.samples[0], m_image + (size_t)m_next_row * m_cols, m_cols * sizeof(int));
+  m_next_row++;
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Decode
+
+void PingPipeline::Decode()
+{
+  int f = -1;
+  while(true) {
+    unsigned long seen = m_wakes;
+    if(f < 0 && !m_free.Pop(f)) {
+      f = -1;
+      if(!Idle(seen))
+        return;
+      continue;
+    }
+    Frame &frame = m_frames[f];
+    if(!TakePing(frame)) {
+      if(!Idle(seen))
+        return;
+      continue;
+    }
+    frame.stamp[1] = Clock::now();
+    m_decoded.Push(f);   // never full, there are only as many frames as slots
+    Wake();
+    f = -1;
+  }
+}
+
+//---------------------------------------------------------
+// Procedure: Analyze
+
+void PingPipeline::Analyze()
+{
+  int f;
+  unsigned long seq = 0;
+  while(true) {
+    unsigned long seen = m_wakes;
+    if(!m_decoded.Pop(f)) {
+      if(!Idle(seen))
+        return;
+      continue;
+    }
+    Frame &frame = m_frames[f];
+    frame.result.peak.index = -1;
+    frame.result.padded_index = -1;
+    m_processor.Process(&frame.samples[0], frame.cols, frame.result);
+
+    // The processor's buffer is reused by the next ping, the log stage gets its own copy
+    frame.padded_size = 0;
+    if(frame.result.padded_index >= 0) {
+      frame.padded_size = m_processor.PaddedSize();
+      memcpy(&frame.padded[0], m_processor.Padded(), frame.padded_size * sizeof(int));
+    }
+    frame.stamp[2] = Clock::now();
+
+    {
+      lock_guard<mutex> lock(m_mutex);
+      m_latest.seq    = ++seq;
+      m_latest.cols   = frame.cols;
+      m_latest.result = frame.result;
+      m_latest.when   = frame.stamp[2];
+    }
+    m_latest_changed.notify_all();
+    m_analyzed.Push(f);
+    Wake();
+  }
+}
+
+//---------------------------------------------------------
+// Procedure: Log
+
+void PingPipeline::Log()
+{
+  static const char out_of_bounds[] = "$bounds is less that $offset, would write out of bounds\n";
+  int f;
+  while(true) {
+    unsigned long seen = m_wakes;
+    if(!m_analyzed.Pop(f)) {
+      if(!Idle(seen))
+        return;
+      continue;
+    }
+    Frame &frame = m_frames[f];
+    const PingPeak &peak = frame.result.peak;
+
+    if(m_log && m_log_maximums >= 0) {
+      m_record.clear();
+      LogAppendValue(m_record, peak.index, ",");
+      LogAppendValue(m_record, peak.value, ",");
+      LogAppendValue(m_record, peak.position, "\n");
+      m_log->Write(m_log_maximums, m_record);
+    }
+    if(m_log && m_log_padded >= 0) {
+      if(frame.padded_size > 0) {
+        m_record.clear();
+        LogAppendRow(m_record, &frame.padded[0], frame.padded_size);
+        m_log->Write(m_log_padded, m_record);
+      }
+      else
+        m_log->Write(m_log_padded, out_of_bounds, sizeof(out_of_bounds) - 1);
+    }
+    if(m_log && m_log_raw >= 0) {
+      m_record.clear();
+      LogAppendRow(m_record, &frame.samples[0], frame.cols);
+      m_log->Write(m_log_raw, m_record);
+    }
+    if(m_telemetry)
+      m_telemetry->Write(TLM_MAXIMUM, peak.index, peak.value, peak.position);
+    frame.stamp[3] = Clock::now();
+
+    {
+      lock_guard<mutex> lock(m_mutex);
+      for(int s = 0; s < PIPE_STAGES; s++) {
+        Clock::time_point from = (s == PIPE_TOTAL) ? frame.stamp[0] : frame.stamp[s];
+        Clock::time_point to   = (s == PIPE_TOTAL) ? frame.stamp[3] : frame.stamp[s + 1];
+        double ms = chrono::duration<double, milli>(to - from).count();
+        m_sum_ms[s] += ms;
+        if(ms > m_max_ms[s])
+          m_max_ms[s] = ms;
+      }
+      m_count++;
+    }
+    m_free.Push(f);
+    Wake();
+  }
+}
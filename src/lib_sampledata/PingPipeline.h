@@ -0,0 +1,164 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingPipeline.h                                       */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Runs pIncludeSampleData's ping processing on three worker threads so a
+// slow ping never holds up the app's Iterate():
+//
+//   decode   takes a ping from the image (one per RequestRow()) or the
+//            newest from a PingStream, into a frame
+//   analyze  runs the PingProcessor on it and makes it the latest detection
+//   log      writes the raw, padded and maximums records to AsyncLogWriter,
+//            and a maximum record to the TelemetryLog
+//
+// Frames are allocated by Start() and go round decode -> analyze -> log ->
+// decode through SPSC queues, so the stages share nothing else and nothing
+// is allocated per ping. When every frame is busy the decode stage waits,
+// and a live stream counts the pings it couldn't hand over as dropped.
+//
+// Each frame is timestamped when its ping is asked for (RequestRow()) or
+// received off the stream and as it leaves each stage, Latency() gives the
+// time from one stage to the next (queue wait included) and end to end.
+// Idle threads sleep on a condition variable until a queue, the stream or
+// RequestRow() wakes them.
+
+#ifndef PingPipeline_HEADER
+#define PingPipeline_HEADER
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include "SpscQueue.h"
+#include "PingProcessor.h"
+#include "PingStream.h"
+#include "AsyncLogWriter.h"
+#include "TelemetryLog.h"
+
+enum PipelineStage
+{
+  PIPE_DECODE  = 0,   // from the ping being asked for or received to decoded
+  PIPE_ANALYZE = 1,   // decoded to analysed
+  PIPE_LOG     = 2,   // analysed to logged
+  PIPE_TOTAL   = 3,   // end to end
+  PIPE_STAGES  = 4
+};
+
+struct PipelineLatency
+{
+  unsigned long count;
+  double        mean_ms;
+  double        max_ms;
+};
+
+struct PingDetection
+{
+  unsigned long seq;     // counts up from 1 with each analysed ping
+  int           cols;
+  PingResult    result;
+  std::chrono::steady_clock::time_point when;   // when it was analysed
+};
+
+class PingPipeline
+{
+ public:
+   PingPipeline();
+   ~PingPipeline();
+
+   // Where pings come from, one or the other. The image (rows pings of cols
+   // samples) or stream must outlive the pipeline
+   void SetImage(const int *image, int rows, int cols);
+   void SetStream(PingStream *stream);
+
+   // Log files of log to write each ping to, -1 for ones that are off
+   void SetLogs(AsyncLogWriter *log, int raw, int padded, int maximums);
+   void SetTelemetry(TelemetryLog *telemetry) {m_telemetry = telemetry;}
+
+   // Configure and seed before Start()
+   PingProcessor& Processor() {return(m_processor);}
+
+   // Allocates frames pings of up to Processor().MaxCols() samples and
+   // starts the threads. Each thread stops once its queue is empty, so a
+   // ping still in flight may not be logged
+   void Start(int frames);
+   void Stop();
+   bool Running() const {return(m_running);}
+
+   // Asks for the next row of the image, false once they've all been asked for
+   bool RequestRow();
+
+   // Waits up to timeout seconds for the detection of the last row asked
+   // for, false if it didn't come in time
+   bool WaitForRow(PingDetection &det, double timeout);
+
+   // The newest detection, false if there hasn't been one yet
+   bool Latest(PingDetection &det) const;
+
+   // Per stage latency since the last reset, indexed by PipelineStage
+   void Latency(PipelineLatency latency[PIPE_STAGES], bool reset = true);
+
+ protected:
+   struct Frame
+   {
+     std::vector<int> samples;
+     std::vector<int> padded;
+     int        cols;
+     int        padded_size;
+     PingResult result;
+     std::chrono::steady_clock::time_point stamp[PIPE_STAGES];   // start, decoded, analysed, logged
+   };
+
+   void Decode();
+   void Analyze();
+   void Log();
+   bool TakePing(Frame &frame);
+   bool Idle(unsigned long seen);
+   void Wake();
+   static void WakeStream(void *pipeline);
+
+ protected:
+   const int   *m_image;
+   int          m_rows;
+   int          m_cols;
+   PingStream  *m_stream;
+   AsyncLogWriter *m_log;
+   int          m_log_raw;
+   int          m_log_padded;
+   int          m_log_maximums;
+   TelemetryLog *m_telemetry;
+
+   PingProcessor m_processor;   // used by the analyze thread only once started
+   std::string  m_record;       // used by the log thread only once started
+
+   std::vector<Frame> m_frames;
+   SpscQueue<int> m_free;       // log -> decode
+   SpscQueue<int> m_decoded;    // decode -> analyze
+   SpscQueue<int> m_analyzed;   // analyze -> log
+
+   bool m_running;
+   std::atomic<bool> m_stop;
+   std::thread m_threads[3];
+
+   std::atomic<int> m_requested;   // rows asked for
+   int  m_next_row;                // rows decoded, decode thread only
+   std::vector<std::chrono::steady_clock::time_point> m_request_at;   // when each row was asked for
+
+   std::mutex m_wake_mutex;        // guards m_wakes changing
+   std::condition_variable m_wake;
+   std::atomic<unsigned long> m_wakes;   // counts up with every push, row and ping
+
+   mutable std::mutex m_mutex;     // guards everything below
+   std::condition_variable m_latest_changed;
+   PingDetection m_latest;
+   double        m_sum_ms[PIPE_STAGES];
+   double        m_max_ms[PIPE_STAGES];
+   unsigned long m_count;
+};
+
+#endif
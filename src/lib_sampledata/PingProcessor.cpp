@@ -0,0 +1,96 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingProcessor.cpp                                    */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "PingProcessor.h"
+
+using namespace std;
+
+//---------------------------------------------------------
+// Constructor
+
+PingProcessor::PingProcessor()
+{
+  m_max_cols      = 0;
+  m_window_start  = 0;
+  m_window_end    = 0;
+  m_refine        = PING_REFINE_NONE;
+  m_pad_fraction  = 0.2;
+  m_wiggle_bounds = 10;
+  m_padded_size   = 0;
+}
+
+//---------------------------------------------------------
+// Procedure: Configure
+
+void PingProcessor::Configure(int max_cols, int window_start, int window_end, int refine,
+                              double pad_fraction, int wiggle_bounds)
+{
+  m_max_cols      = (max_cols < 0) ? 0 : max_cols;
+  m_window_start  = window_start;
+  m_window_end    = window_end;
+  m_refine        = refine;
+  m_pad_fraction  = pad_fraction;
+  m_wiggle_bounds = (wiggle_bounds < 0) ? 0 : wiggle_bounds;
+
+  // The padding grows with the ping, so the longest ping needs the most
+  int offset = round(m_pad_fraction * m_max_cols / 2);
+  m_padded.assign(m_max_cols + 2 * offset, 0);
+  m_padded_size = 0;
+}
+
+//---------------------------------------------------------
+// Procedure: Process
+
+bool PingProcessor::Process(const int *ping, int cols, PingResult &result)
+{
+  if(cols < 0 || cols > m_max_cols)
+    return(false);
+  FindPeak(ping, cols, result);
+  Pad(ping, cols, result);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: FindPeak
+
+void PingProcessor::FindPeak(const int *ping, int cols, PingResult &result)
+{
+  result.peak = PingFindPeak(ping, cols, m_window_start, m_window_end, m_refine);
+}
+
+//---------------------------------------------------------
+// Procedure: Pad
+
+void PingProcessor::Pad(const int *ping, int cols, PingResult &result)
+{
+  // Drawn for every ping, whether or not it fits, so the sequence of
+  // wiggles only depends on the seed and the number of pings
+  int offset = round(m_pad_fraction * cols / 2);
+  result.wiggle = m_noise.Draw(-m_wiggle_bounds, m_wiggle_bounds);
+  result.offset = offset;
+  m_padded_size = cols + 2 * offset;
+
+  // The wiggle has to stay inside the padding. It's checked itself too, so
+  // the buffer never depends on the noise source keeping to its bounds
+  if(m_wiggle_bounds >= offset || abs(result.wiggle) >= offset) {
+    result.padded_index = -1;
+    return;
+  }
+
+  int *padded = &m_padded[0];
+  int start = offset + result.wiggle;
+  memset(padded, 0, start * sizeof(int));
+  memcpy(padded + start, ping, cols * sizeof(int));
+  memset(padded + start + cols, 0, (m_padded_size - start - cols) * sizeof(int));
+
+  // Searched with the same window as the ping itself
+  result.padded_index = PingArgMax(padded, max(m_window_start, 0), min(m_window_end, m_padded_size));
+}
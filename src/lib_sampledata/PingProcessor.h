@@ -0,0 +1,72 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingProcessor.h                                      */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// The per-ping analysis pIncludeSampleData runs each tick. It finds the
+// bottom return of the ping, then copies the ping into a zero padded buffer
+// at a random offset (the simulated "wiggle" of the vehicle) and finds the
+// return in that copy too.
+//
+// Configure() sizes every buffer for the longest ping, so Process() never
+// allocates. The wiggle comes from Noise(), which can be seeded, recorded
+// and replayed (see NoiseSource.h).
+
+#ifndef PingProcessor_HEADER
+#define PingProcessor_HEADER
+
+#include <vector>
+#include <stdint.h>
+#include "PingPeak.h"
+#include "NoiseSource.h"
+
+struct PingResult
+{
+  PingPeak peak;          // return in the ping itself, index -1 if the window is empty
+  int      wiggle;        // where the ping sits in the padded copy, relative to centered
+  int      offset;        // padding on each side of the ping
+  int      padded_index;  // return in the padded copy, -1 if the wiggle could overrun the padding
+};
+
+class PingProcessor
+{
+ public:
+   PingProcessor();
+
+   // pad_fraction of the ping's length is added as padding, split between
+   // the two ends, and the wiggle is drawn from [-wiggle_bounds, wiggle_bounds]
+   void Configure(int max_cols, int window_start, int window_end, int refine,
+                  double pad_fraction = 0.2, int wiggle_bounds = 10);
+   void Seed(uint32_t seed) {m_noise.SetSeed(seed);}
+   NoiseSource& Noise() {return(m_noise);}
+
+   // Analyses one ping, false if it's longer than max_cols
+   bool Process(const int *ping, int cols, PingResult &result);
+
+   // The two halves of Process(), for timing them apart. Neither checks cols
+   void FindPeak(const int *ping, int cols, PingResult &result);
+   void Pad(const int *ping, int cols, PingResult &result);
+
+   // The padded copy of the last ping, valid when its padded_index >= 0
+   const int* Padded() const {return(m_padded.empty() ? NULL : &m_padded[0]);}
+   int  PaddedSize() const {return(m_padded_size);}
+   int  PaddedCapacity() const {return(m_padded.size());}
+   int  MaxCols() const {return(m_max_cols);}
+
+ protected:
+   int    m_max_cols;
+   int    m_window_start;
+   int    m_window_end;
+   int    m_refine;
+   double m_pad_fraction;
+   int    m_wiggle_bounds;
+
+   std::vector<int> m_padded;
+   int    m_padded_size;
+
+   NoiseSource m_noise;
+};
+
+#endif
@@ -0,0 +1,459 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingStream.cpp                                       */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include "PingFile.h"
+#include "PingStream.h"
+
+using namespace std;
+
+static_assert(sizeof(PingRecordHeader) == 16, "the ping record header is 16 bytes on the wire");
+
+//---------------------------------------------------------
+// Procedure: PingEncodeRecord
+
+bool PingEncodeRecord(vector<char> &record, uint32_t seq, const int *samples,
+                      uint32_t cols, uint32_t dtype)
+{
+  size_t bytes = PingDTypeBytes(dtype);
+  if(bytes == 0)
+    return(false);
+
+  PingRecordHeader hdr;
+  memcpy(hdr.magic, PING_RECORD_MAGIC, 4);
+  hdr.seq = seq;
+  hdr.cols = cols;
+  hdr.dtype = dtype;
+  hdr.reserved = 0;
+  record.resize(sizeof(hdr) + cols * bytes);
+  memcpy(&record[0], &hdr, sizeof(hdr));
+
+  char *out = &record[sizeof(hdr)];
+  for(uint32_t c = 0; c < cols; c++) {
+    int v = samples[c];
+    if(dtype == PING_U8) {
+      if(v < 0 || v > UINT8_MAX) return(false);
+      uint8_t s = v;
+      memcpy(out + c, &s, 1);
+    }
+    else if(dtype == PING_U16) {
+      if(v < 0 || v > UINT16_MAX) return(false);
+      uint16_t s = v;
+      memcpy(out + c * 2, &s, 2);
+    }
+    else if(dtype == PING_I32) {
+      int32_t s = v;
+      memcpy(out + c * 4, &s, 4);
+    }
+    else {
+      float s = v;
+      memcpy(out + c * 4, &s, 4);
+    }
+  }
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: SplitSource
+//   Notes: "udp:5600" -> ("udp", "", "5600"), "udp:host:5600" ->
+//          ("udp", "host", "5600"), "fifo:/tmp/p" -> ("fifo", "", "/tmp/p")
+
+static bool SplitSource(const string &source, string &kind, string &host, string &rest)
+{
+  size_t colon = source.find(':');
+  if(colon == string::npos)
+    return(false);
+  kind = source.substr(0, colon);
+  rest = source.substr(colon + 1);
+  host = "";
+  if(kind == "udp") {
+    size_t port_colon = rest.rfind(':');
+    if(port_colon != string::npos) {
+      host = rest.substr(0, port_colon);
+      rest = rest.substr(port_colon + 1);
+    }
+  }
+  return(rest != "");
+}
+
+//---------------------------------------------------------
+// Procedure: PingOpenSender
+
+int PingOpenSender(const string &target, string &err)
+{
+  string kind, host, rest;
+  if(!SplitSource(target, kind, host, rest)) {
+    err = "bad ping target " + target;
+    return(-1);
+  }
+
+  int fd = -1;
+  if(kind == "fifo") {
+    fd = open(rest.c_str(), O_WRONLY);   // waits for the reader to open its end
+  }
+  else if(kind == "unix") {
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, rest.c_str(), sizeof(addr.sun_path) - 1);
+    if(fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  else if(kind == "udp") {
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if(getaddrinfo(host == "" ? "127.0.0.1" : host.c_str(), rest.c_str(), &hints, &res) == 0) {
+      fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+      if(fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        close(fd);
+        fd = -1;
+      }
+      freeaddrinfo(res);
+    }
+  }
+  else {
+    err = "unknown ping target type " + kind;
+    return(-1);
+  }
+  if(fd < 0)
+    err = "can't open " + target + ": " + strerror(errno);
+  return(fd);
+}
+
+//---------------------------------------------------------
+// Procedure: PingSendRecord
+
+bool PingSendRecord(int fd, const vector<char> &record)
+{
+  size_t sent = 0;
+  while(sent < record.size()) {
+    ssize_t n = write(fd, &record[sent], record.size() - sent);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n <= 0)
+      return(false);
+    sent += n;
+  }
+  return(true);
+}
+
+//---------------------------------------------------------
+// Constructor
+
+PingStream::PingStream()
+{
+  m_fd = -1;
+  m_datagram = false;
+  m_slots = 0;
+  m_max_cols = 0;
+  m_stop = false;
+  m_buffered = 0;
+  m_write_slot = 0;
+  m_have_seq = false;
+  m_last_seq = 0;
+  m_newest = -1;
+  m_received = 0;
+  m_taken_upto = 0;
+  m_dropped = 0;
+  m_lost = 0;
+  m_bad = 0;
+  m_notify = NULL;
+  m_notify_arg = NULL;
+}
+
+//---------------------------------------------------------
+// Destructor
+
+PingStream::~PingStream()
+{
+  Close();
+}
+
+//---------------------------------------------------------
+// Procedure: Open
+
+bool PingStream::Open(const string &source, int slots, int max_cols, string &err)
+{
+  Close();
+  string kind, host, rest;
+  if(!SplitSource(source, kind, host, rest)) {
+    err = "bad ping source " + source;
+    return(false);
+  }
+
+  if(kind == "fifo") {
+    // Made if it isn't there. Opened read-write so the FIFO never reads as
+    // closed when a sender goes away, the next sender just carries on
+    if(mkfifo(rest.c_str(), 0644) != 0 && errno != EEXIST) {
+      err = "can't make FIFO " + rest + ": " + strerror(errno);
+      return(false);
+    }
+    m_fd = open(rest.c_str(), O_RDWR | O_NONBLOCK);
+    m_datagram = false;
+  }
+  else if(kind == "unix") {
+    m_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, rest.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(rest.c_str());
+    if(m_fd >= 0 && bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+    m_unix_path = rest;
+    m_datagram = true;
+  }
+  else if(kind == "udp") {
+    m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(atoi(rest.c_str()));
+    if(m_fd >= 0 && bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+    m_datagram = true;
+  }
+  else {
+    err = "unknown ping source type " + kind;
+    return(false);
+  }
+  if(m_fd < 0) {
+    err = "can't open " + source + ": " + strerror(errno);
+    return(false);
+  }
+
+  // Everything the reader needs is allocated here, none of it grows later
+  m_slots = (slots < 2) ? 2 : slots;
+  m_max_cols = (max_cols < 1) ? 1 : max_cols;
+  m_samples.assign((size_t)m_slots * m_max_cols, 0);
+  m_cols.assign(m_slots, 0);
+  m_arrived.assign(m_slots, chrono::steady_clock::time_point());
+  m_buffer.assign(2 * (sizeof(PingRecordHeader) + (size_t)m_max_cols * 4), 0);
+  m_buffered = 0;
+  m_write_slot = 0;
+  m_have_seq = false;
+  m_newest = -1;
+  m_received = m_taken_upto = m_dropped = m_lost = m_bad = 0;
+
+  m_stop = false;
+  m_thread = thread(&PingStream::Run, this);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Close
+
+void PingStream::Close()
+{
+  if(m_fd < 0)
+    return;
+  m_stop = true;
+  m_thread.join();
+  close(m_fd);
+  m_fd = -1;
+  if(m_unix_path != "")
+    unlink(m_unix_path.c_str());
+  m_unix_path = "";
+}
+
+//---------------------------------------------------------
+// Procedure: TakeNewest
+
+bool PingStream::TakeNewest(int *dest, int &cols, chrono::steady_clock::time_point *arrived)
+{
+  lock_guard<mutex> lock(m_mutex);
+  if(m_newest < 0 || m_received == m_taken_upto)
+    return(false);
+  m_dropped += m_received - m_taken_upto - 1;
+  m_taken_upto = m_received;
+  cols = m_cols[m_newest];
+  if(arrived)
+    *arrived = m_arrived[m_newest];
+  memcpy(dest, &m_samples[(size_t)m_newest * m_max_cols], cols * sizeof(int));
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: SetNotify
+
+void PingStream::SetNotify(void (*notify)(void *), void *arg)
+{
+  lock_guard<mutex> lock(m_mutex);
+  m_notify = notify;
+  m_notify_arg = arg;
+}
+
+//---------------------------------------------------------
+// Procedure: Received, Dropped, Lost, Bad
+
+unsigned long PingStream::Received() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_received);
+}
+
+unsigned long PingStream::Dropped() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_dropped);
+}
+
+unsigned long PingStream::Lost() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_lost);
+}
+
+unsigned long PingStream::Bad() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_bad);
+}
+
+//---------------------------------------------------------
+// Procedure: Store
+//   Notes: decodes one whole record into the write slot, then
+//          makes it the newest. The app only ever copies the
+//          newest slot, so the write slot is never being read
+
+void PingStream::Store(const char *record, size_t len)
+{
+  PingRecordHeader hdr;
+  size_t bytes = 0;
+  bool ok = (len >= sizeof(hdr));
+  if(ok) {
+    memcpy(&hdr, record, sizeof(hdr));
+    bytes = PingDTypeBytes(hdr.dtype);
+    ok = (memcmp(hdr.magic, PING_RECORD_MAGIC, 4) == 0) && (bytes > 0) &&
+         (hdr.cols <= (uint32_t)m_max_cols) && (len == sizeof(hdr) + hdr.cols * bytes);
+  }
+  if(!ok) {
+    lock_guard<mutex> lock(m_mutex);
+    m_bad++;
+    return;
+  }
+
+  int *dest = &m_samples[(size_t)m_write_slot * m_max_cols];
+  const char *src = record + sizeof(hdr);
+  for(uint32_t c = 0; c < hdr.cols; c++) {
+    if(hdr.dtype == PING_U8)
+      dest[c] = (uint8_t)src[c];
+    else if(hdr.dtype == PING_U16) {
+      uint16_t v;
+      memcpy(&v, src + c * 2, 2);
+      dest[c] = v;
+    }
+    else if(hdr.dtype == PING_I32) {
+      int32_t v;
+      memcpy(&v, src + c * 4, 4);
+      dest[c] = v;
+    }
+    else {
+      float v;
+      memcpy(&v, src + c * 4, 4);
+      dest[c] = (int)(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+  }
+  m_cols[m_write_slot] = hdr.cols;
+  m_arrived[m_write_slot] = chrono::steady_clock::now();
+
+  void (*notify)(void *);
+  void *arg;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    // seq wraps at 2^32. A gap of half the range or more is taken for a
+    // sender that restarted, not for lost pings
+    uint32_t gap = hdr.seq - m_last_seq - 1;
+    if(m_have_seq && gap < 0x80000000u)
+      m_lost += gap;
+    m_have_seq = true;
+    m_last_seq = hdr.seq;
+    m_received++;
+    m_newest = m_write_slot;
+    m_write_slot = (m_write_slot + 1) % m_slots;
+    notify = m_notify;
+    arg = m_notify_arg;
+  }
+  if(notify)
+    notify(arg);
+}
+
+//---------------------------------------------------------
+// Procedure: Run
+//   Notes: datagrams are whole records. A FIFO is a byte stream,
+//          so records are cut out of m_buffer as they complete,
+//          skipping ahead to the next magic after garbage
+
+void PingStream::Run()
+{
+  struct pollfd pfd;
+  pfd.fd = m_fd;
+  pfd.events = POLLIN;
+
+  while(!m_stop) {
+    if(poll(&pfd, 1, 200) <= 0)
+      continue;
+
+    if(m_datagram) {
+      ssize_t n = recv(m_fd, &m_buffer[0], m_buffer.size(), MSG_DONTWAIT);
+      if(n > 0)
+        Store(&m_buffer[0], n);
+      continue;
+    }
+
+    ssize_t n = read(m_fd, &m_buffer[m_buffered], m_buffer.size() - m_buffered);
+    if(n <= 0)
+      continue;
+    m_buffered += n;
+
+    size_t pos = 0;
+    bool skipping = false;
+    while(m_buffered - pos >= sizeof(PingRecordHeader)) {
+      PingRecordHeader hdr;
+      memcpy(&hdr, &m_buffer[pos], sizeof(hdr));
+      size_t bytes = PingDTypeBytes(hdr.dtype);
+      if(memcmp(hdr.magic, PING_RECORD_MAGIC, 4) != 0 || bytes == 0 ||
+         hdr.cols > (uint32_t)m_max_cols) {
+        if(!skipping) {
+          lock_guard<mutex> lock(m_mutex);
+          m_bad++;
+        }
+        skipping = true;
+        pos++;
+        continue;
+      }
+      skipping = false;
+      size_t len = sizeof(hdr) + hdr.cols * bytes;
+      if(m_buffered - pos < len)
+        break;   // the rest of it hasn't arrived yet
+      Store(&m_buffer[pos], len);
+      pos += len;
+    }
+    memmove(&m_buffer[0], &m_buffer[pos], m_buffered - pos);
+    m_buffered -= pos;
+  }
+}
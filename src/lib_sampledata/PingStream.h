@@ -0,0 +1,121 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: PingStream.h                                         */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Live pings for pIncludeSampleData. A background thread reads ping records
+// from a FIFO, a UNIX datagram socket or a UDP port into a ring of slots
+// allocated up front, and the app takes the newest ping whenever it's ready
+// for one. Pings the app never got to are counted as dropped, gaps in the
+// sender's sequence numbers as lost.
+//
+// Sources are named "fifo:/path", "unix:/path" or "udp:port" (receiving) and
+// "udp:host:port" (sending, see ping_replay). Each ping is one record, one
+// datagram per record on the sockets and back to back on a FIFO:
+//
+//   offset  size  field
+//        0     4  magic "SPNG"
+//        4     4  seq, counts up by one per ping from the sender
+//        8     4  cols, samples in this ping
+//       12     2  dtype, one of PingDType (see PingFile.h)
+//       14     2  reserved, 0
+//       16        cols samples of dtype, host byte order (little endian on
+//                 the supported targets, see PingFile.h)
+
+#ifndef PingStream_HEADER
+#define PingStream_HEADER
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#define PING_RECORD_MAGIC "SPNG"
+
+struct PingRecordHeader
+{
+  char     magic[4];
+  uint32_t seq;
+  uint32_t cols;
+  uint16_t dtype;
+  uint16_t reserved;
+};
+
+// Builds the record for one ping of cols samples in record, which is
+// resized to fit. Returns false if a sample doesn't fit in dtype
+bool PingEncodeRecord(std::vector<char> &record, uint32_t seq, const int *samples,
+                      uint32_t cols, uint32_t dtype);
+
+// Opens a sending end of "fifo:/path", "unix:/path" or "udp:host:port", for
+// stand-ins and tests. Returns a file descriptor for PingSendRecord or -1
+int  PingOpenSender(const std::string &target, std::string &err);
+bool PingSendRecord(int fd, const std::vector<char> &record);
+
+class PingStream
+{
+ public:
+   PingStream();
+   ~PingStream();
+
+   // Binds or opens source and starts the reader. slots is how many pings
+   // the ring holds (at least 2), max_cols the most samples a ping may
+   // have, longer ones are counted as bad
+   bool Open(const std::string &source, int slots, int max_cols, std::string &err);
+   void Close();
+   bool IsOpen() const {return(m_fd >= 0);}
+
+   // Copies the newest ping into dest (at least max_cols long) if there is
+   // one that hasn't been taken yet. cols gets its length, and arrived, if
+   // given, when it was received
+   bool TakeNewest(int *dest, int &cols,
+                   std::chrono::steady_clock::time_point *arrived = NULL);
+
+   // notify(arg) is called from the reader thread after each ping is
+   // received, so a consumer can sleep until there is one. NULL for none
+   void SetNotify(void (*notify)(void *), void *arg);
+
+   unsigned long Received() const;
+   unsigned long Dropped() const;   // received but never taken
+   unsigned long Lost() const;      // never received, from gaps in seq
+   unsigned long Bad() const;       // records that didn't parse
+
+ protected:
+   void Run();
+   void Store(const char *record, size_t len);
+
+ protected:
+   int  m_fd;
+   bool m_datagram;
+   int  m_slots;
+   int  m_max_cols;
+   std::atomic<bool> m_stop;
+   std::thread m_thread;
+   std::string m_unix_path;   // removed again on Close()
+
+   // Written by the reader thread only. slot s holds m_samples[s * m_max_cols, ...)
+   std::vector<int> m_samples;
+   std::vector<int> m_cols;
+   std::vector<std::chrono::steady_clock::time_point> m_arrived;
+   std::vector<char> m_buffer;
+   size_t m_buffered;
+   int  m_write_slot;
+   bool m_have_seq;
+   uint32_t m_last_seq;
+
+   mutable std::mutex m_mutex;   // guards everything below
+   int  m_newest;                // slot of the newest ping, -1 before the first
+   unsigned long m_received;
+   unsigned long m_taken_upto;   // m_received when the app last took a ping
+   unsigned long m_dropped;
+   unsigned long m_lost;
+   unsigned long m_bad;
+   void (*m_notify)(void *);
+   void *m_notify_arg;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: SpscQueue.h                                          */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// A bounded queue between exactly one producer thread and one consumer
+// thread, without locks. The slots are allocated by Reset(), Push() and
+// Pop() never allocate and never wait, they return false when the queue
+// is full or empty.
+
+#ifndef SpscQueue_HEADER
+#define SpscQueue_HEADER
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+template <class T>
+class SpscQueue
+{
+ public:
+   explicit SpscQueue(size_t capacity = 0) : m_head(0), m_tail(0) {Reset(capacity);}
+
+   // Empties the queue and makes room for capacity items. Neither thread
+   // may be using it
+   void Reset(size_t capacity)
+   {
+     m_items.assign(capacity + 1, T());   // one slot always stays empty
+     m_head.store(0);
+     m_tail.store(0);
+   }
+
+   // Producer side
+   bool Push(const T &item)
+   {
+     size_t tail = m_tail.load(std::memory_order_relaxed);
+     size_t next = (tail + 1) % m_items.size();
+     if(next == m_head.load(std::memory_order_acquire))
+       return(false);
+     m_items[tail] = item;
+     m_tail.store(next, std::memory_order_release);
+     return(true);
+   }
+
+   // Consumer side
+   bool Pop(T &item)
+   {
+     size_t head = m_head.load(std::memory_order_relaxed);
+     if(head == m_tail.load(std::memory_order_acquire))
+       return(false);
+     item = m_items[head];
+     m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+     return(true);
+   }
+
+ protected:
+   std::vector<T> m_items;
+   alignas(64) std::atomic<size_t> m_head;   // next to pop, written by the consumer
+   alignas(64) std::atomic<size_t> m_tail;   // next to push, written by the producer
+};
+
+#endif
@@ -0,0 +1,505 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: TelemetryLog.cpp                                     */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <sys/types.h>
+#include "TelemetryLog.h"
+
+using namespace std;
+
+static_assert(sizeof(TelemetryFileHeader) == 24, "the telemetry file header is 24 bytes");
+static_assert(sizeof(TelemetryRecord) == 32, "telemetry records are 32 bytes");
+static_assert(sizeof(TelemetryBlockHeader) == 24, "telemetry block headers are 24 bytes");
+static_assert(sizeof(TelemetryIndexEntry) == 32, "telemetry index entries are 32 bytes");
+static_assert(sizeof(TelemetryTrailer) == 16, "the telemetry trailer is 16 bytes");
+
+static const char *type_names[TLM_TYPES] = {"", "position", "maximum", "waypoint"};
+static const char *type_columns[TLM_TYPES] = {
+  "",
+  "nav_x,nav_y,heading,max_index,distance",
+  "index,value,position",
+  "nav_x,nav_y,point_x,point_y,distance"
+};
+static const int type_counts[TLM_TYPES] = {0, 5, 3, 5};
+
+//---------------------------------------------------------
+// Procedure: TelemetryTypeFromName, TelemetryTypeName,
+//            TelemetryColumns
+
+int TelemetryTypeFromName(const string &name)
+{
+  for(int t = 1; t < TLM_TYPES; t++)
+    if(name == type_names[t])
+      return(t);
+  return(0);
+}
+
+string TelemetryTypeName(int type)
+{
+  return((type > 0 && type < TLM_TYPES) ? type_names[type] : "");
+}
+
+string TelemetryColumns(int type)
+{
+  return((type > 0 && type < TLM_TYPES) ? type_columns[type] : "");
+}
+
+//---------------------------------------------------------
+// Procedure: SystemClock
+//   Notes: the default clock, seconds since 1970
+
+static double SystemClock()
+{
+  return(chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count());
+}
+
+//---------------------------------------------------------
+// Constructor
+
+TelemetryLog::TelemetryLog()
+{
+  m_fp = NULL;
+  m_clock = SystemClock;
+  m_flush = 5.0;
+  m_failed = false;
+  m_offset = 0;
+  m_block_used = 0;
+  m_spare_used = 0;
+  m_pending = false;
+  m_stop = false;
+  m_records = 0;
+}
+
+//---------------------------------------------------------
+// Destructor
+
+TelemetryLog::~TelemetryLog()
+{
+  Close();
+}
+
+//---------------------------------------------------------
+// Procedure: Open
+
+bool TelemetryLog::Open(const string &path, string &err, int block_records, double flush)
+{
+  Close();
+  lock_guard<mutex> lock(m_mutex);
+  m_fp = fopen(path.c_str(), "wb");
+  if(!m_fp) {
+    err = "can't create " + path + ": " + strerror(errno);
+    return(false);
+  }
+
+  TelemetryFileHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, TELEMETRY_FILE_MAGIC, 8);
+  hdr.version = TELEMETRY_FILE_VERSION;
+  hdr.header_bytes = sizeof(hdr);
+  hdr.record_bytes = sizeof(TelemetryRecord);
+  if(fwrite(&hdr, sizeof(hdr), 1, m_fp) != 1 || fflush(m_fp) != 0) {
+    err = "error writing " + path;
+    fclose(m_fp);
+    m_fp = NULL;
+    return(false);
+  }
+
+  m_block.assign((block_records < 1) ? 1 : block_records, TelemetryRecord());
+  m_spare.assign(m_block.size(), TelemetryRecord());
+  m_block_used = 0;
+  m_spare_used = 0;
+  m_index.clear();
+  m_index.reserve(1024);   // a few hours of a busy log before it grows
+  m_offset = sizeof(hdr);
+  m_flush = flush;
+  m_failed = false;
+  m_pending = false;
+  m_stop = false;
+  m_records = 0;
+  m_thread = thread(&TelemetryLog::Run, this);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Close
+//   Notes: the index is only written here, a log without one
+//          is still read through its block headers
+
+void TelemetryLog::Close()
+{
+  {
+    unique_lock<mutex> lock(m_mutex);
+    if(!m_fp)
+      return;
+    m_written.wait(lock, [this]{return(!m_pending);});
+    if(m_block_used > 0)
+      HandOver();
+    m_stop = true;
+    m_wake.notify_all();
+  }
+  m_thread.join();
+
+  lock_guard<mutex> lock(m_mutex);
+  if(!m_failed) {
+    TelemetryTrailer trailer;
+    memcpy(trailer.magic, TELEMETRY_INDEX_MAGIC, 4);
+    trailer.blocks = m_index.size();
+    trailer.index_offset = m_offset;
+    if(!m_index.empty())
+      fwrite(&m_index[0], sizeof(TelemetryIndexEntry), m_index.size(), m_fp);
+    fwrite(&trailer, sizeof(trailer), 1, m_fp);
+  }
+  fclose(m_fp);
+  m_fp = NULL;
+}
+
+//---------------------------------------------------------
+// Procedure: Write
+
+void TelemetryLog::Write(int type, const double *values, int count)
+{
+  double now = m_clock();
+  if(count > TELEMETRY_VALUES)
+    count = TELEMETRY_VALUES;
+
+  unique_lock<mutex> lock(m_mutex);
+  if(!m_fp)
+    return;
+  // A full block is handed over before storing into it. The wait for the
+  // writer lets other threads in, so it's checked again after
+  while(m_block_used == m_block.size()) {
+    m_written.wait(lock, [this]{return(!m_pending);});
+    if(!m_fp)
+      return;
+    if(m_block_used == m_block.size())
+      HandOver();
+  }
+  if(m_block_used == 0) {
+    m_block_started = chrono::steady_clock::now();
+    m_wake.notify_all();   // so the writer times the flush from now
+  }
+  TelemetryRecord &rec = m_block[m_block_used++];
+  rec.time = now;
+  rec.type = type;
+  rec.count = count;
+  for(int v = 0; v < TELEMETRY_VALUES; v++)
+    rec.values[v] = (v < count) ? values[v] : 0;
+  m_records++;
+
+  if(m_block_used == m_block.size() && !m_pending)
+    HandOver();
+}
+
+void TelemetryLog::Write(int type, double v0, double v1, double v2, double v3, double v4)
+{
+  const double values[TELEMETRY_VALUES] = {v0, v1, v2, v3, v4};
+  Write(type, values, (type > 0 && type < TLM_TYPES) ? type_counts[type] : TELEMETRY_VALUES);
+}
+
+//---------------------------------------------------------
+// Procedure: Flush
+
+void TelemetryLog::Flush()
+{
+  unique_lock<mutex> lock(m_mutex);
+  if(!m_fp)
+    return;
+  m_written.wait(lock, [this]{return(!m_pending);});
+  if(m_block_used > 0) {
+    HandOver();
+    m_written.wait(lock, [this]{return(!m_pending);});
+  }
+}
+
+//---------------------------------------------------------
+// Procedure: Records
+
+unsigned long TelemetryLog::Records() const
+{
+  lock_guard<mutex> lock(m_mutex);
+  return(m_records);
+}
+
+//---------------------------------------------------------
+// Procedure: HandOver
+//   Notes: called with m_mutex held and nothing pending. The
+//          filled block becomes the writer's and the spare one
+//          is filled next
+
+void TelemetryLog::HandOver()
+{
+  m_block.swap(m_spare);
+  m_spare_used = m_block_used;
+  m_block_used = 0;
+  m_pending = true;
+  m_wake.notify_all();
+}
+
+//---------------------------------------------------------
+// Procedure: Run
+//   Notes: the writer thread. Writes each block handed over,
+//          and hands over the block being filled itself once
+//          it's been open flush seconds
+
+void TelemetryLog::Run()
+{
+  chrono::steady_clock::duration flush =
+    chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(m_flush));
+  unique_lock<mutex> lock(m_mutex);
+  while(true) {
+    if(m_pending) {
+      const TelemetryRecord *block = &m_spare[0];
+      size_t used = m_spare_used;
+      lock.unlock();
+      WriteBlock(block, used);
+      lock.lock();
+      m_pending = false;
+      m_written.notify_all();
+      continue;
+    }
+    if(m_stop)
+      return;
+    if(m_block_used == 0)
+      m_wake.wait(lock);
+    else if(chrono::steady_clock::now() >= m_block_started + flush)
+      HandOver();
+    else
+      m_wake.wait_until(lock, m_block_started + flush);
+  }
+}
+
+//---------------------------------------------------------
+// Procedure: WriteBlock
+//   Notes: writer thread only. After a failed write the rest
+//          of the log is dropped rather than leaving a hole that
+//          the block headers can't be walked past
+
+bool TelemetryLog::WriteBlock(const TelemetryRecord *block, size_t used)
+{
+  if(used == 0 || m_failed)
+    return(false);
+
+  TelemetryIndexEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.offset = m_offset;
+  entry.count = used;
+  entry.t_first = entry.t_last = block[0].time;
+  for(size_t r = 1; r < used; r++) {
+    entry.t_first = min(entry.t_first, block[r].time);
+    entry.t_last  = max(entry.t_last, block[r].time);
+  }
+
+  TelemetryBlockHeader hdr;
+  memcpy(hdr.magic, TELEMETRY_BLOCK_MAGIC, 4);
+  hdr.count = entry.count;
+  hdr.t_first = entry.t_first;
+  hdr.t_last = entry.t_last;
+
+  bool ok = (fwrite(&hdr, sizeof(hdr), 1, m_fp) == 1) &&
+            (fwrite(block, sizeof(TelemetryRecord), used, m_fp) == used) &&
+            (fflush(m_fp) == 0);
+  if(!ok) {
+    m_failed = true;
+    return(false);
+  }
+  m_index.push_back(entry);
+  m_offset += sizeof(hdr) + used * sizeof(TelemetryRecord);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Constructor
+
+TelemetryReader::TelemetryReader()
+{
+  m_fp = NULL;
+  m_indexed = false;
+  memset(&m_header, 0, sizeof(m_header));
+}
+
+//---------------------------------------------------------
+// Destructor
+
+TelemetryReader::~TelemetryReader()
+{
+  Close();
+}
+
+//---------------------------------------------------------
+// Procedure: Open
+
+bool TelemetryReader::Open(const string &path, string &err)
+{
+  Close();
+  m_fp = fopen(path.c_str(), "rb");
+  if(!m_fp) {
+    err = "can't open " + path + ": " + strerror(errno);
+    return(false);
+  }
+  if(fread(&m_header, sizeof(m_header), 1, m_fp) != 1 ||
+     memcmp(m_header.magic, TELEMETRY_FILE_MAGIC, 8) != 0) {
+    err = path + " is not a telemetry log";
+    Close();
+    return(false);
+  }
+  if(m_header.version != TELEMETRY_FILE_VERSION || m_header.header_bytes < sizeof(m_header) ||
+     m_header.record_bytes < sizeof(TelemetryRecord)) {
+    err = path + " is a telemetry log version this reader doesn't know";
+    Close();
+    return(false);
+  }
+
+  fseeko(m_fp, 0, SEEK_END);
+  uint64_t size = ftello(m_fp);
+  m_indexed = ReadIndex(size);
+  if(!m_indexed)
+    ScanBlocks(size);
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: Close
+
+void TelemetryReader::Close()
+{
+  if(m_fp)
+    fclose(m_fp);
+  m_fp = NULL;
+  m_blocks.clear();
+  m_indexed = false;
+}
+
+//---------------------------------------------------------
+// Procedure: ReadIndex
+//   Notes: false if there's no trailer or it doesn't add up,
+//          so the blocks are scanned instead
+
+bool TelemetryReader::ReadIndex(uint64_t size)
+{
+  TelemetryTrailer trailer;
+  if(size < m_header.header_bytes + sizeof(trailer))
+    return(false);
+  fseeko(m_fp, size - sizeof(trailer), SEEK_SET);
+  if(fread(&trailer, sizeof(trailer), 1, m_fp) != 1 ||
+     memcmp(trailer.magic, TELEMETRY_INDEX_MAGIC, 4) != 0 ||
+     trailer.index_offset < m_header.header_bytes ||
+     trailer.index_offset + (uint64_t)trailer.blocks * sizeof(TelemetryIndexEntry) + sizeof(trailer) != size)
+    return(false);
+
+  m_blocks.resize(trailer.blocks);
+  fseeko(m_fp, trailer.index_offset, SEEK_SET);
+  if(trailer.blocks > 0 &&
+     fread(&m_blocks[0], sizeof(TelemetryIndexEntry), trailer.blocks, m_fp) != trailer.blocks) {
+    m_blocks.clear();
+    return(false);
+  }
+  for(size_t b = 0; b < m_blocks.size(); b++) {
+    if(m_blocks[b].offset + sizeof(TelemetryBlockHeader) +
+       (uint64_t)m_blocks[b].count * m_header.record_bytes > trailer.index_offset) {
+      m_blocks.clear();
+      return(false);
+    }
+  }
+  return(true);
+}
+
+//---------------------------------------------------------
+// Procedure: ScanBlocks
+//   Notes: hops from block header to block header, stopping at
+//          the first one that's missing or cut short
+
+bool TelemetryReader::ScanBlocks(uint64_t size)
+{
+  m_blocks.clear();
+  uint64_t pos = m_header.header_bytes;
+  while(pos + sizeof(TelemetryBlockHeader) <= size) {
+    TelemetryBlockHeader hdr;
+    fseeko(m_fp, pos, SEEK_SET);
+    if(fread(&hdr, sizeof(hdr), 1, m_fp) != 1 || memcmp(hdr.magic, TELEMETRY_BLOCK_MAGIC, 4) != 0)
+      break;
+    uint64_t whole = (size - pos - sizeof(hdr)) / m_header.record_bytes;
+    TelemetryIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.offset = pos;
+    entry.count = min<uint64_t>(hdr.count, whole);
+    entry.t_first = hdr.t_first;
+    entry.t_last = hdr.t_last;
+    if(entry.count > 0)
+      m_blocks.push_back(entry);
+    if(entry.count < hdr.count)
+      break;
+    pos += sizeof(hdr) + (uint64_t)hdr.count * m_header.record_bytes;
+  }
+  return(!m_blocks.empty());
+}
+
+//---------------------------------------------------------
+// Procedure: Records, StartTime, EndTime
+
+unsigned long TelemetryReader::Records() const
+{
+  unsigned long records = 0;
+  for(size_t b = 0; b < m_blocks.size(); b++)
+    records += m_blocks[b].count;
+  return(records);
+}
+
+double TelemetryReader::StartTime() const
+{
+  double t = 0;
+  for(size_t b = 0; b < m_blocks.size(); b++)
+    if(b == 0 || m_blocks[b].t_first < t)
+      t = m_blocks[b].t_first;
+  return(t);
+}
+
+double TelemetryReader::EndTime() const
+{
+  double t = 0;
+  for(size_t b = 0; b < m_blocks.size(); b++)
+    if(b == 0 || m_blocks[b].t_last > t)
+      t = m_blocks[b].t_last;
+  return(t);
+}
+
+//---------------------------------------------------------
+// Procedure: Read
+
+bool TelemetryReader::Read(double from, double to, unsigned type_mask,
+                           vector<TelemetryRecord> &records, string &err)
+{
+  if(!m_fp) {
+    err = "no telemetry log open";
+    return(false);
+  }
+  vector<char> buffer;
+  for(size_t b = 0; b < m_blocks.size(); b++) {
+    const TelemetryIndexEntry &block = m_blocks[b];
+    if(block.t_last < from || block.t_first > to)
+      continue;
+
+    buffer.resize((size_t)block.count * m_header.record_bytes);
+    fseeko(m_fp, block.offset + sizeof(TelemetryBlockHeader), SEEK_SET);
+    if(fread(&buffer[0], m_header.record_bytes, block.count, m_fp) != block.count) {
+      err = "telemetry log truncated in a block";
+      return(false);
+    }
+    for(uint32_t r = 0; r < block.count; r++) {
+      TelemetryRecord rec;
+      memcpy(&rec, &buffer[(size_t)r * m_header.record_bytes], sizeof(rec));
+      if(rec.time < from || rec.time > to)
+        continue;
+      if(type_mask != 0 && (rec.type >= 32 || !(type_mask & (1u << rec.type))))
+        continue;
+      records.push_back(rec);
+    }
+  }
+  return(true);
+}
@@ -0,0 +1,208 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: TelemetryLog.h                                       */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Binary mission telemetry, the compact replacement for the position and
+// maximums csv outputs. Every record is 32 bytes: a time, a TelemetryType
+// and up to five values. Records are written in blocks, each with its own
+// header giving its record count and time span, and Close() ends the file
+// with an index of the blocks, so a time range of a long mission is read
+// by seeking to the blocks that cover it instead of parsing the whole log.
+// Everything is in host byte order, little endian on the supported targets
+// (checked below).
+//
+//   file header   24 bytes, magic "SAMSTLM1", version, header_bytes,
+//                 record_bytes
+//   block         24 byte TelemetryBlockHeader, then count records
+//   ...
+//   index         one TelemetryIndexEntry per block
+//   trailer       16 bytes, magic "TIDX", blocks, offset of the index
+//
+// A log whose app was killed has no index. The reader then walks the block
+// headers instead, still without reading the records, and keeps the whole
+// records of a block that was cut short.
+//
+// Blocks are written by a background thread, so Write() never waits on the
+// filesystem: a full block is handed over and records go on into a second
+// one while it's written. A block is handed over when it's full or flush
+// seconds (real time, whatever the log's clock) after its first record,
+// whichever comes first, so that is as much as a crash loses.
+
+#ifndef TelemetryLog_HEADER
+#define TelemetryLog_HEADER
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <stdint.h>
+
+// Files are read and written as the host's structs, with no byte swapping
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "telemetry logs are little endian, this host is not"
+#endif
+
+#define TELEMETRY_FILE_MAGIC   "SAMSTLM1"
+#define TELEMETRY_FILE_VERSION 1
+#define TELEMETRY_BLOCK_MAGIC  "TBLK"
+#define TELEMETRY_INDEX_MAGIC  "TIDX"
+#define TELEMETRY_VALUES       5
+
+enum TelemetryType
+{
+  TLM_POSITION = 1,   // pIncludeSampleData: nav_x, nav_y, heading, max_index, distance
+  TLM_MAXIMUM  = 2,   // pIncludeSampleData, each ping: index, value, position
+  TLM_WAYPOINT = 3,   // pLineFollow: nav_x, nav_y, point_x, point_y, averaged distance
+  TLM_TYPES    = 4
+};
+
+struct TelemetryFileHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_bytes;
+  uint32_t record_bytes;
+  uint32_t reserved;
+};
+
+struct TelemetryRecord
+{
+  double   time;      // seconds, from the log's clock
+  uint16_t type;      // TelemetryType
+  uint16_t count;     // values used
+  float    values[TELEMETRY_VALUES];
+};
+
+struct TelemetryBlockHeader
+{
+  char     magic[4];
+  uint32_t count;     // records that follow
+  double   t_first;   // earliest and latest record times in the block
+  double   t_last;
+};
+
+struct TelemetryIndexEntry
+{
+  uint64_t offset;    // of the block header
+  uint32_t count;
+  uint32_t reserved;
+  double   t_first;
+  double   t_last;
+};
+
+struct TelemetryTrailer
+{
+  char     magic[4];
+  uint32_t blocks;
+  uint64_t index_offset;
+};
+
+// "position", "maximum" or "waypoint" to a TelemetryType and back, 0 and ""
+// if it isn't one of those
+int TelemetryTypeFromName(const std::string &name);
+std::string TelemetryTypeName(int type);
+
+// Names of the values of a type, comma separated, as the csv outputs had them
+std::string TelemetryColumns(int type);
+
+class TelemetryLog
+{
+ public:
+   TelemetryLog();
+   ~TelemetryLog();
+
+   // Times come from clock, seconds since 1970 by default. Apps pass one
+   // that returns MOOSTime() so the log lines up with the alogs
+   void SetClock(double (*clock)()) {m_clock = clock;}
+
+   // Creates path, replacing any log already there, and starts the writer.
+   // block_records records are kept in memory before being written
+   bool Open(const std::string &path, std::string &err,
+             int block_records = 1024, double flush = 5.0);
+   bool IsOpen() const {return(m_fp != NULL);}
+
+   // Writes out the last block and the index and stops the writer
+   void Close();
+
+   // Adds a record of count values stamped with the clock, from any thread.
+   // Nothing is allocated unless the index needs to grow. Only waits if the
+   // block is full and the writer is still on the last one
+   void Write(int type, const double *values, int count);
+   void Write(int type, double v0, double v1 = 0, double v2 = 0, double v3 = 0, double v4 = 0);
+
+   // Writes out the block in memory, if it has anything in it, and waits
+   // until it's on disk
+   void Flush();
+
+   unsigned long Records() const;
+
+ protected:
+   void Run();
+   void HandOver();
+   bool WriteBlock(const TelemetryRecord *block, size_t used);
+
+ protected:
+   FILE  *m_fp;
+   double (*m_clock)();
+   double m_flush;
+   std::thread m_thread;
+
+   // Used by the writer thread only while it runs
+   bool   m_failed;
+   std::vector<TelemetryIndexEntry> m_index;
+   uint64_t m_offset;
+
+   mutable std::mutex m_mutex;         // guards everything below
+   std::condition_variable m_wake;     // the writer waits on this
+   std::condition_variable m_written;  // and signals this after each block
+   std::vector<TelemetryRecord> m_block;   // being filled
+   size_t m_block_used;
+   std::chrono::steady_clock::time_point m_block_started;
+   std::vector<TelemetryRecord> m_spare;   // being written while m_pending
+   size_t m_spare_used;
+   bool   m_pending;
+   bool   m_stop;
+   unsigned long m_records;
+};
+
+class TelemetryReader
+{
+ public:
+   TelemetryReader();
+   ~TelemetryReader();
+
+   // Reads the header and the index, or the block headers if there isn't one
+   bool Open(const std::string &path, std::string &err);
+   void Close();
+
+   // From the index, without reading any records
+   const std::vector<TelemetryIndexEntry>& Blocks() const {return(m_blocks);}
+   bool   Indexed() const {return(m_indexed);}
+   unsigned long Records() const;
+   double StartTime() const;
+   double EndTime() const;
+
+   // Appends the records of the types in type_mask (bit 1 << type, 0 for all)
+   // with times in [from, to] to records, reading only the blocks that
+   // overlap. Records are in the order they were written
+   bool Read(double from, double to, unsigned type_mask,
+             std::vector<TelemetryRecord> &records, std::string &err);
+
+ protected:
+   bool ReadIndex(uint64_t size);
+   bool ScanBlocks(uint64_t size);
+
+ protected:
+   FILE *m_fp;
+   TelemetryFileHeader m_header;
+   std::vector<TelemetryIndexEntry> m_blocks;
+   bool m_indexed;
+};
+
+#endif
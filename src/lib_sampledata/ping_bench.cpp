@@ -0,0 +1,327 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: ping_bench.cpp                                       */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Measures how many pings a second pIncludeSampleData's analysis keeps up
+// with, to size the sonar rate against. Each ping goes through the same
+// steps as in the app: row extraction, peak detection, padding and the
+// distance conversion. The benchmark reports pings/sec, latency percentiles
+// per step and the heap allocations made while pings were processed.
+//
+//   ping_bench [--pings=800] [--bins=500] [--seed=1] [--repeat=50]
+//              [--image=file] [--window=0:150] [--refine=parabolic]
+//              [--pipeline] [--frames=4] [--log=dir]
+//
+// The image is made the way missions/*/synthetic_image_generator makes
+// synthetic_image.png: one gaussian return per ping, 100 to 125 bins out,
+// with its width varying bin to bin, scaled to 0-255. The same seed gives
+// the same image and the same wiggles, so runs can be compared. --image
+// takes a ping file, PNG or csv image instead, e.g. the generator's own
+// synthetic_image.png.
+//
+// --pipeline instead runs the image once through PingPipeline's threads,
+// as fast as they will go. --log then writes the pipeline's outputs to
+// dir, the way the app does.
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include "PingFile.h"
+#include "PingPeak.h"
+#include "PingProcessor.h"
+#include "PingPipeline.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//---------------------------------------------------------
+// Heap allocations, counted from every thread
+
+static atomic<unsigned long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+  g_allocations++;
+  void *p = malloc(size ? size : 1);
+  if(!p)
+    throw bad_alloc();
+  return(p);
+}
+
+// GCC can't see that these free what the operator new above malloc'd
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+//---------------------------------------------------------
+// Procedure: SyntheticImage
+//   Notes: the model of synthetic_image_generator/src/main.rs,
+//          with its random draws from a seeded mt19937 so the
+//          image can be made again
+
+static void SyntheticImage(vector<int> &image, int pings, int bins, uint32_t seed)
+{
+  mt19937 rng(seed);
+  auto uniform = [&rng](double lo, double hi) {return(lo + (hi - lo) * (rng() + 0.5) / 4294967296.0);};
+
+  const double sigma_base = 5.0;
+  const double mu_base = 100.0;
+  vector<double> f((size_t)pings * bins, 0.0);
+  double max = 0;
+  for(int x = 0; x < pings; x++) {
+    double mu_var = uniform(0.0, 25.0);
+    double mu = mu_base + mu_var;
+    for(int y = 0; y < bins; y++) {
+      double sigma = sigma_base + uniform(0.0, 2.0);
+      double v = (1.0 / (2.0 * M_PI * sigma * sigma)) * exp(-(y - mu) * (y - mu) / (2.0 * sigma * sigma));
+      if(y > (int)(mu - mu_var + 10.0))
+        v = 0;
+      f[(size_t)x * bins + y] = v;
+      max = std::max(max, v);
+    }
+  }
+
+  image.resize(f.size());
+  for(size_t k = 0; k < f.size(); k++)
+    image[k] = (max > 0) ? (int)(f[k] / max * 255) : 0;
+}
+
+//---------------------------------------------------------
+// Procedure: Percentiles
+
+static void Percentiles(const string &name, vector<double> &ns)
+{
+  if(ns.empty())
+    return;
+  sort(ns.begin(), ns.end());
+  double sum = 0;
+  for(size_t k = 0; k < ns.size(); k++)
+    sum += ns[k];
+  const int pct[] = {50, 90, 99};
+  cout << "  " << setw(12) << left << name << right << "  mean " << setw(8) << sum / ns.size();
+  for(int p = 0; p < 3; p++)
+    cout << "  p" << pct[p] << " " << setw(8) << ns[min(ns.size() - 1, size_t(ns.size() * pct[p] / 100))];
+  cout << "  max " << setw(8) << ns.back() << "  ns" << endl;
+}
+
+//---------------------------------------------------------
+// Procedure: RunInline
+//   Notes: one pass untimed per step for throughput, then one
+//          timing every step of every ping
+
+static void RunInline(const vector<int> &image, int rows, int cols, int repeat,
+                      PingProcessor &processor, uint32_t seed)
+{
+  const double range_scale = 10.5/106, range_offset = 0;
+  size_t n = (size_t)rows * repeat;
+  vector<int> ping(cols);
+  vector<double> t_extract(n), t_peak(n), t_pad(n), t_distance(n);
+  PingResult result;
+  double checksum = 0;
+
+  unsigned long allocations = g_allocations;
+  processor.Seed(seed);
+  Clock::time_point start = Clock::now();
+  for(int r = 0; r < repeat; r++) {
+    for(int row = 0; row < rows; row++) {
+      copy(&image[(size_t)row * cols], &image[(size_t)row * cols] + cols, ping.begin());
+      processor.FindPeak(&ping[0], cols, result);
+      processor.Pad(&ping[0], cols, result);
+      checksum += range_offset + result.peak.position * range_scale;
+    }
+  }
+  double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+  processor.Seed(seed);
+  size_t k = 0;
+  for(int r = 0; r < repeat; r++) {
+    for(int row = 0; row < rows; row++, k++) {
+      Clock::time_point t0 = Clock::now();
+      copy(&image[(size_t)row * cols], &image[(size_t)row * cols] + cols, ping.begin());
+      Clock::time_point t1 = Clock::now();
+      processor.FindPeak(&ping[0], cols, result);
+      Clock::time_point t2 = Clock::now();
+      processor.Pad(&ping[0], cols, result);
+      Clock::time_point t3 = Clock::now();
+      volatile double distance = range_offset + result.peak.position * range_scale;
+      (void)distance;
+      Clock::time_point t4 = Clock::now();
+      t_extract[k]  = chrono::duration<double, nano>(t1 - t0).count();
+      t_peak[k]     = chrono::duration<double, nano>(t2 - t1).count();
+      t_pad[k]      = chrono::duration<double, nano>(t3 - t2).count();
+      t_distance[k] = chrono::duration<double, nano>(t4 - t3).count();
+    }
+  }
+  allocations = g_allocations - allocations;
+
+  cout << fixed << setprecision(0);
+  cout << n << " pings in " << setprecision(3) << seconds << " s: " << setprecision(0)
+       << n / seconds << " pings/sec, " << allocations << " allocations" << endl;
+  cout << setprecision(6) << "distance checksum " << checksum << setprecision(0) << endl;
+  cout << "per ping, with timer overhead:" << endl;
+  Percentiles("extract", t_extract);
+  Percentiles("peak", t_peak);
+  Percentiles("pad", t_pad);
+  Percentiles("distance", t_distance);
+}
+
+//---------------------------------------------------------
+// Procedure: RunPipeline
+
+static void RunPipeline(const vector<int> &image, int rows, int cols, int frames,
+                        const string &log_dir, PingPipeline &pipeline)
+{
+  AsyncLogWriter log;
+  TelemetryLog telemetry;
+  if(log_dir != "") {
+    mkdir(log_dir.c_str(), 0755);
+    int raw = log.Open(log_dir + "/output.csv");
+    int padded = log.Open(log_dir + "/padded_output.csv");
+    int maximums = log.Open(log_dir + "/maximums_output.csv");
+    pipeline.SetLogs(&log, raw, padded, maximums);
+    log.Start();
+    string err;
+    if(telemetry.Open(log_dir + "/sample_data.tlm", err))
+      pipeline.SetTelemetry(&telemetry);
+  }
+  pipeline.SetImage(&image[0], rows, cols);
+  pipeline.Start(frames);
+
+  unsigned long allocations = g_allocations;
+  Clock::time_point start = Clock::now();
+  while(pipeline.RequestRow())
+    ;
+  PingDetection det;
+  if(!pipeline.WaitForRow(det, 600))
+    cout << "the last ping wasn't analysed in 10 minutes" << endl;
+  double seconds = chrono::duration<double>(Clock::now() - start).count();
+  allocations = g_allocations - allocations;
+
+  // The last ping's log record lands a moment after its detection
+  this_thread::sleep_for(chrono::milliseconds(50));
+  PipelineLatency latency[PIPE_STAGES];
+  pipeline.Latency(latency);
+  pipeline.Stop();
+  log.Stop();
+  telemetry.Close();
+
+  const char *names[PIPE_STAGES] = {"decode", "analyze", "log", "total"};
+  cout << fixed << setprecision(0);
+  cout << rows << " pings through " << frames << " frames in " << setprecision(3) << seconds
+       << " s: " << setprecision(0) << rows / seconds << " pings/sec, " << allocations
+       << " allocations" << endl;
+  cout << "per ping, queue waits included:" << endl;
+  for(int s = 0; s < PIPE_STAGES; s++)
+    cout << "  " << setw(12) << left << names[s] << right << "  mean " << setw(8)
+         << latency[s].mean_ms * 1e6 << "  max " << setw(8) << latency[s].max_ms * 1e6 << "  ns" << endl;
+  if(log.Dropped() > 0)
+    cout << "the log writer dropped " << log.Dropped() << " records" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+  int pings = 800, bins = 500, repeat = 50, frames = 4;
+  int window_start = 0, window_end = 150;
+  uint32_t seed = 1;
+  int refine = PING_REFINE_PARABOLIC;
+  bool pipeline = false;
+  string image_path, log_dir;
+
+  for(int i=1; i<argc; i++) {
+    string argi = argv[i];
+    if(argi.find("--pings=") == 0)
+      pings = atoi(argi.substr(8).c_str());
+    else if(argi.find("--bins=") == 0)
+      bins = atoi(argi.substr(7).c_str());
+    else if(argi.find("--seed=") == 0)
+      seed = strtoul(argi.substr(7).c_str(), NULL, 10);
+    else if(argi.find("--repeat=") == 0)
+      repeat = atoi(argi.substr(9).c_str());
+    else if(argi.find("--image=") == 0)
+      image_path = argi.substr(8);
+    else if(argi.find("--window=") == 0) {
+      string window = argi.substr(9);
+      window_start = atoi(window.c_str());
+      size_t colon = window.find(':');
+      if(colon != string::npos)
+        window_end = atoi(window.substr(colon + 1).c_str());
+    }
+    else if(argi.find("--refine=") == 0) {
+      refine = PingRefineFromName(argi.substr(9));
+      if(refine < 0) {
+        cout << "ping_bench: unknown refinement " << argi.substr(9) << endl;
+        return(1);
+      }
+    }
+    else if(argi == "--pipeline")
+      pipeline = true;
+    else if(argi.find("--frames=") == 0)
+      frames = atoi(argi.substr(9).c_str());
+    else if(argi.find("--log=") == 0)
+      log_dir = argi.substr(6);
+    else {
+      cout << "Usage: ping_bench [--pings=N] [--bins=N] [--seed=N] [--repeat=N] [--image=file]" << endl;
+      cout << "                  [--window=start:end] [--refine=none|parabolic|centroid]" << endl;
+      cout << "                  [--pipeline] [--frames=N] [--log=dir]" << endl;
+      return(1);
+    }
+  }
+  if(repeat < 1)
+    repeat = 1;
+
+  vector<int> image;
+  uint32_t rows = pings, cols = bins;
+  if(image_path != "") {
+    string err;
+    PingFileHeader hdr;
+    bool ok = PingReadImage(image_path, image, hdr, err);
+    rows = hdr.rows;
+    cols = hdr.cols;
+    if(!ok || rows == 0) {
+      cout << "ping_bench: " << (ok ? "no pings in " + image_path : err) << endl;
+      return(1);
+    }
+    cout << "image: " << image_path << ", ";
+  }
+  else {
+    SyntheticImage(image, rows, cols, seed);
+    cout << "image: synthetic, seed " << seed << ", ";
+  }
+  cout << rows << " pings of " << cols << " samples, window " << window_start << ":" << window_end << endl;
+
+  if(pipeline) {
+    PingPipeline runner;
+    runner.Processor().Configure(cols, window_start, window_end, refine);
+    runner.Processor().Seed(seed);
+    RunPipeline(image, rows, cols, frames, log_dir, runner);
+  }
+  else {
+    PingProcessor processor;
+    processor.Configure(cols, window_start, window_end, refine);
+    RunInline(image, rows, cols, repeat, processor, seed);
+  }
+  return(0);
+}
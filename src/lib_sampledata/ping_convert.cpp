@@ -0,0 +1,91 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: ping_convert.cpp                                     */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Converts the csv or PNG sample images used by pIncludeSampleData to binary
+// ping files, and ping files back to csv:
+//
+//   ping_convert csv_image_import.csv pings.ping [--dtype=u8|u16|i32|f32]
+//                [--range_scale=M] [--range_offset=M]
+//   ping_convert synthetic_image.png pings.ping
+//   ping_convert pings.ping check.csv
+//
+// The direction comes from the input, a ping file is written out as csv and
+// anything else is read as a PNG or csv image. Without --dtype the smallest
+// integer type that holds every sample is used. --range_scale is meters per
+// column, it defaults to the 10.5/106 pIncludeSampleData has always used.
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "PingFile.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  string in_path, out_path;
+  uint32_t dtype = 0;
+  double range_scale = 10.5/106;
+  double range_offset = 0;
+
+  for(int i=1; i<argc; i++) {
+    string argi = argv[i];
+    if(argi.find("--dtype=") == 0) {
+      dtype = PingDTypeFromName(argi.substr(8));
+      if(dtype == 0) {
+        cout << "ping_convert: unknown dtype " << argi.substr(8) << endl;
+        return(1);
+      }
+    }
+    else if(argi.find("--range_scale=") == 0)
+      range_scale = atof(argi.substr(14).c_str());
+    else if(argi.find("--range_offset=") == 0)
+      range_offset = atof(argi.substr(15).c_str());
+    else if(in_path == "")
+      in_path = argi;
+    else if(out_path == "")
+      out_path = argi;
+  }
+  if(in_path == "" || out_path == "") {
+    cout << "Usage: ping_convert in.csv|in.png out.ping [--dtype=u8|u16|i32|f32] "
+         << "[--range_scale=M] [--range_offset=M]" << endl;
+    cout << "       ping_convert in.ping out.csv" << endl;
+    return(1);
+  }
+
+  vector<int> samples;
+  string err;
+  if(PingIsBinary(in_path)) {
+    PingFileHeader hdr;
+    if(!PingRead(in_path, samples, hdr, err) ||
+       !PingWriteCsv(out_path, samples.empty() ? NULL : &samples[0], hdr.rows, hdr.cols, err)) {
+      cout << "ping_convert: " << err << endl;
+      return(1);
+    }
+    cout << "ping_convert: wrote " << hdr.rows << " pings of " << hdr.cols
+         << " samples to " << out_path << " (range scale " << hdr.range_scale << " m)" << endl;
+    return(0);
+  }
+
+  PingFileHeader hdr;
+  if(!PingReadImage(in_path, samples, hdr, err)) {
+    cout << "ping_convert: " << err << endl;
+    return(1);
+  }
+  uint32_t rows = hdr.rows, cols = hdr.cols;
+  const int *data = samples.empty() ? NULL : &samples[0];
+  if(dtype == 0)
+    dtype = PingSmallestDType(data, samples.size());
+  if(!PingWrite(out_path, data, rows, cols, dtype, range_scale, range_offset, err)) {
+    cout << "ping_convert: " << err << endl;
+    return(1);
+  }
+  cout << "ping_convert: wrote " << rows << " pings of " << cols << " samples ("
+       << PingDTypeBytes(dtype) << " bytes each) to " << out_path << endl;
+  return(0);
+}
@@ -0,0 +1,112 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: ping_replay.cpp                                      */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Stands in for the sonar: plays a ping file (or PNG or csv image) to a
+// pIncludeSampleData INPUT_STREAM at a fixed rate, one record per ping:
+//
+//   ping_replay pings.ping udp:127.0.0.1:5600 [--rate=Hz] [--loop]
+//               [--dtype=u8|u16|i32|f32]
+//   ping_replay csv_image_import.csv fifo:/tmp/sonar_pings --rate=50
+//
+// --rate defaults to 10 pings a second, 0 sends as fast as possible. Pings go
+// out in the file's own dtype unless --dtype says otherwise.
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "PingFile.h"
+#include "PingStream.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  string in_path, target;
+  double rate = 10;
+  bool loop = false;
+  uint32_t dtype = 0;
+
+  for(int i=1; i<argc; i++) {
+    string argi = argv[i];
+    if(argi.find("--rate=") == 0)
+      rate = atof(argi.substr(7).c_str());
+    else if(argi == "--loop")
+      loop = true;
+    else if(argi.find("--dtype=") == 0) {
+      dtype = PingDTypeFromName(argi.substr(8));
+      if(dtype == 0) {
+        cout << "ping_replay: unknown dtype " << argi.substr(8) << endl;
+        return(1);
+      }
+    }
+    else if(in_path == "")
+      in_path = argi;
+    else if(target == "")
+      target = argi;
+  }
+  if(in_path == "" || target == "") {
+    cout << "Usage: ping_replay in.ping|in.png|in.csv fifo:/path|unix:/path|udp:host:port "
+         << "[--rate=Hz] [--loop] [--dtype=u8|u16|i32|f32]" << endl;
+    return(1);
+  }
+
+  vector<int> samples;
+  PingFileHeader hdr;
+  string err;
+  if(!PingReadImage(in_path, samples, hdr, err)) {
+    cout << "ping_replay: " << err << endl;
+    return(1);
+  }
+  uint32_t rows = hdr.rows, cols = hdr.cols;
+  if(dtype == 0)
+    dtype = hdr.dtype;
+  if(rows == 0) {
+    cout << "ping_replay: no pings in " << in_path << endl;
+    return(1);
+  }
+  if(dtype == 0)
+    dtype = PingSmallestDType(&samples[0], samples.size());
+
+  int fd = PingOpenSender(target, err);
+  if(fd < 0) {
+    cout << "ping_replay: " << err << endl;
+    return(1);
+  }
+
+  chrono::steady_clock::duration period = chrono::steady_clock::duration::zero();
+  if(rate > 0)
+    period = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / rate));
+  chrono::steady_clock::time_point next = chrono::steady_clock::now();
+
+  vector<char> record;
+  uint32_t seq = 0;
+  do {
+    for(uint32_t r = 0; r < rows; r++) {
+      if(!PingEncodeRecord(record, seq++, &samples[(size_t)r * cols], cols, dtype)) {
+        cout << "ping_replay: ping " << r << " doesn't fit in " << PingDTypeBytes(dtype)
+             << " byte samples" << endl;
+        close(fd);
+        return(1);
+      }
+      if(!PingSendRecord(fd, record)) {
+        cout << "ping_replay: send to " << target << " failed" << endl;
+        close(fd);
+        return(1);
+      }
+      next += period;
+      this_thread::sleep_until(next);
+    }
+  } while(loop);
+
+  cout << "ping_replay: sent " << seq << " pings of " << cols << " samples to " << target << endl;
+  close(fd);
+  return(0);
+}
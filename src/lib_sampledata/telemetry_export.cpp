@@ -0,0 +1,125 @@
+/************************************************************/
+/*    NAME: cmoran                                               */
+/*    ORGN: UCSB Coastal Oceanography and Autonomous Systems Lab */
+/*    FILE: telemetry_export.cpp                                 */
+/*    DATE: 16 October 2026                                      */
+/************************************************************/
+
+// Exports a telemetry log (see TelemetryLog.h) to csv, all of it or a slice:
+//
+//   telemetry_export sample_data.tlm [out.csv] [--type=position|maximum|waypoint]
+//                    [--from=S] [--to=S] [--absolute] [--info]
+//
+// --from and --to are seconds into the log, or times as logged (MOOSTime)
+// with --absolute. Only the blocks covering the slice are read. With --type
+// the csv starts with a header row of time and then the columns of the old
+// csv output of that type, e.g. time,nav_x,nav_y,heading,max_index,distance
+// for position. Without it the types are mixed, so there is no header and
+// each line is time,type and the record's values. The csv goes to stdout
+// unless out.csv is given. --info prints the log's blocks and time span
+// instead.
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "TelemetryLog.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+  string in_path, out_path;
+  int type = 0;
+  double from = 0, to = 1e300;
+  bool absolute = false, info = false;
+
+  for(int i=1; i<argc; i++) {
+    string argi = argv[i];
+    if(argi.find("--type=") == 0) {
+      type = TelemetryTypeFromName(argi.substr(7));
+      if(type == 0) {
+        cout << "telemetry_export: unknown record type " << argi.substr(7) << endl;
+        return(1);
+      }
+    }
+    else if(argi.find("--from=") == 0)
+      from = atof(argi.substr(7).c_str());
+    else if(argi.find("--to=") == 0)
+      to = atof(argi.substr(5).c_str());
+    else if(argi == "--absolute")
+      absolute = true;
+    else if(argi == "--info")
+      info = true;
+    else if(in_path == "")
+      in_path = argi;
+    else if(out_path == "")
+      out_path = argi;
+    else
+      in_path = "";
+  }
+  if(in_path == "") {
+    cout << "Usage: telemetry_export in.tlm [out.csv] [--type=position|maximum|waypoint] "
+         << "[--from=S] [--to=S] [--absolute] [--info]" << endl;
+    return(1);
+  }
+
+  TelemetryReader reader;
+  string err;
+  if(!reader.Open(in_path, err)) {
+    cout << "telemetry_export: " << err << endl;
+    return(1);
+  }
+
+  double start = reader.StartTime();
+  if(info) {
+    const vector<TelemetryIndexEntry> &blocks = reader.Blocks();
+    cout << fixed << setprecision(3);
+    cout << in_path << ": " << reader.Records() << " records in " << blocks.size() << " blocks, "
+         << (reader.Indexed() ? "indexed" : "no index (the writer didn't close it)") << endl;
+    if(!blocks.empty())
+      cout << "time " << start << " to " << reader.EndTime() << " (" << reader.EndTime() - start
+           << " s)" << endl;
+    for(size_t b = 0; b < blocks.size(); b++)
+      cout << "  block " << b << " at " << blocks[b].offset << ": " << blocks[b].count
+           << " records, " << blocks[b].t_first - start << " to " << blocks[b].t_last - start << " s" << endl;
+    return(0);
+  }
+
+  if(!absolute) {
+    from += start;
+    to += start;
+  }
+  vector<TelemetryRecord> records;
+  if(!reader.Read(from, to, type ? (1u << type) : 0, records, err)) {
+    cout << "telemetry_export: " << err << endl;
+    return(1);
+  }
+
+  ofstream file;
+  if(out_path != "") {
+    file.open(out_path.c_str());
+    if(!file) {
+      cout << "telemetry_export: can't create " << out_path << endl;
+      return(1);
+    }
+  }
+  ostream &out = (out_path != "") ? file : cout;
+  out << setprecision(16);
+  if(type != 0)
+    out << "time," << TelemetryColumns(type) << "\n";
+  for(size_t r = 0; r < records.size(); r++) {
+    const TelemetryRecord &rec = records[r];
+    out << rec.time;
+    if(type == 0)
+      out << "," << TelemetryTypeName(rec.type);
+    for(int v = 0; v < rec.count && v < TELEMETRY_VALUES; v++)
+      out << "," << setprecision(7) << rec.values[v] << setprecision(16);
+    out << "\n";
+  }
+  if(out_path != "")
+    cout << "telemetry_export: wrote " << records.size() << " records to " << out_path << endl;
+  return(0);
+}
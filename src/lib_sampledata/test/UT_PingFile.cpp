@@ -0,0 +1,204 @@
+//=============================================================================
+/** @file UT_PingFile.cpp
+ *
+ * @brief
+ *	Unit test for PingReadPng: writes PNGs the image crate behind
+ *	image_to_csv_rs decodes differently from a gamma-aware reader (16 bit
+ *	samples, gAMA chunks, gray with alpha, palettes) and checks they read
+ *	back as the samples image_to_csv_rs wrote to its csv for them.
+ *
+ * @author cmoran
+ */
+//=============================================================================
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <png.h>
+
+#include "../PingFile.h"
+
+using namespace std;
+
+
+#define WIDTH  37   // Pings
+#define HEIGHT 23   // Samples per ping
+
+// What image_to_csv_rs gets for a pixel: the image crate (0.23) keeps the
+// high byte of 16 bit samples, ignores alpha and gAMA, then takes the float
+// luma of every pixel, gray ones included, and truncates it
+static int CrateLuma(unsigned r, unsigned g, unsigned b, int bit_depth)
+{
+    if (bit_depth == 16)
+    {
+        r >>= 8;
+        g >>= 8;
+        b >>= 8;
+    }
+    return (int)(0.2126f * r + 0.7152f * g + 0.0722f * b);
+}
+
+// A sample pattern that covers the whole range of a channel, low bytes
+// included
+static unsigned Channel(int x, int y, int c, int bit_depth)
+{
+    unsigned v = (x * 97 + y * 57 + c * 31) % 256;
+    return (bit_depth == 16) ? (v << 8) | ((x * 13 + y * 7 + c) % 256) : v;
+}
+
+// Writes a WIDTH x HEIGHT PNG of color_type and bit_depth with a gAMA chunk
+// of gamma (none if 0), and fills expected with the samples of each ping
+static bool WritePng(const string& path, int color_type, int bit_depth, double gamma,
+                     vector<int>& expected)
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp)
+    {
+        return false;
+    }
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (setjmp(png_jmpbuf(png)))
+    {
+        png_destroy_write_struct(&png, &info);
+        fclose(fp);
+        return false;
+    }
+    png_init_io(png, fp);
+    png_set_IHDR(png, info, WIDTH, HEIGHT, bit_depth, color_type, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_color palette[256];
+    if (color_type == PNG_COLOR_TYPE_PALETTE)
+    {
+        for (int p = 0; p < 256; p++)
+        {
+            palette[p].red = p;
+            palette[p].green = (p * 3) % 256;
+            palette[p].blue = 255 - p;
+        }
+        png_set_PLTE(png, info, palette, 256);
+    }
+    if (gamma > 0)
+    {
+        png_set_gAMA(png, info, gamma);
+    }
+    png_write_info(png, info);
+
+    int channels = (color_type == PNG_COLOR_TYPE_RGB) ? 3 :
+                   (color_type == PNG_COLOR_TYPE_GRAY_ALPHA) ? 2 : 1;
+    int bytes = bit_depth / 8;
+    vector<png_byte> line(WIDTH * channels * bytes);
+    expected.assign(WIDTH * HEIGHT, 0);
+    for (int y = 0; y < HEIGHT; y++)
+    {
+        for (int x = 0; x < WIDTH; x++)
+        {
+            unsigned v[3];
+            for (int c = 0; c < channels; c++)
+            {
+                v[c] = Channel(x, y, c, bit_depth);
+                png_byte* out = &line[(x * channels + c) * bytes];
+                if (bytes == 2)
+                {
+                    out[0] = v[c] >> 8;
+                    out[1] = v[c] & 0xff;
+                }
+                else
+                {
+                    out[0] = v[c];
+                }
+            }
+            if (color_type == PNG_COLOR_TYPE_RGB)
+            {
+                expected[x * HEIGHT + y] = CrateLuma(v[0], v[1], v[2], bit_depth);
+            }
+            else if (color_type == PNG_COLOR_TYPE_PALETTE)
+            {
+                expected[x * HEIGHT + y] = CrateLuma(palette[v[0]].red, palette[v[0]].green,
+                                                     palette[v[0]].blue, 8);
+            }
+            else
+            {
+                expected[x * HEIGHT + y] = CrateLuma(v[0], v[0], v[0], bit_depth);
+            }
+        }
+        png_write_row(png, &line[0]);
+    }
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    fclose(fp);
+    return true;
+}
+
+
+//=============================================================================
+int main()
+{
+    cout << "<< Testing PingReadPng >>\n" << endl;
+
+    struct Case
+    {
+        const char* name;
+        int color_type;
+        int bit_depth;
+        double gamma;
+    };
+    Case cases[] = {
+        {"16 bit RGB, gAMA 1.0",        PNG_COLOR_TYPE_RGB,        16, 1.0},
+        {"16 bit gray, gAMA 1/2.2",     PNG_COLOR_TYPE_GRAY,       16, 1 / 2.2},
+        {"16 bit gray and alpha",       PNG_COLOR_TYPE_GRAY_ALPHA, 16, 0},
+        {"8 bit gray, gAMA 1.0",        PNG_COLOR_TYPE_GRAY,        8, 1.0},
+        {"8 bit RGB",                   PNG_COLOR_TYPE_RGB,         8, 0},
+        {"8 bit palette, gAMA 1/2.2",   PNG_COLOR_TYPE_PALETTE,     8, 1 / 2.2},
+    };
+    string path = "UT_PingFile.png";
+    int failures = 0;
+
+    for (size_t t = 0; t < sizeof(cases) / sizeof(cases[0]); t++)
+    {
+        vector<int> expected, samples;
+        uint32_t rows = 0, cols = 0;
+        string err;
+        if ( !WritePng(path, cases[t].color_type, cases[t].bit_depth, cases[t].gamma, expected) )
+        {
+            cout << "Could not write " << path << ", test FAILED!" << endl;
+            return -1;
+        }
+        if ( !PingIsPng(path) || !PingReadPng(path, samples, rows, cols, err) )
+        {
+            cout << cases[t].name << ": " << err << endl;
+            failures++;
+            continue;
+        }
+        size_t wrong = 0;
+        for (size_t s = 0; s < samples.size() && s < expected.size(); s++)
+        {
+            wrong += (samples[s] != expected[s]);
+        }
+        if (rows != WIDTH || cols != HEIGHT || samples != expected)
+        {
+            cout << cases[t].name << ": " << rows << "x" << cols << ", " << wrong
+                 << " samples differ from image_to_csv_rs" << endl;
+            failures++;
+        }
+    }
+
+    // The crate's float luma of a gray pixel isn't always the pixel, a gray
+    // 13 comes out of image_to_csv_rs as 12
+    if (CrateLuma(13, 13, 13, 8) != 12 || CrateLuma(0x0dff, 0x0dff, 0x0dff, 16) != 12)
+    {
+        cout << "Gray 13 should read as 12" << endl;
+        failures++;
+    }
+    remove(path.c_str());
+
+    if (failures > 0)
+    {
+        cout << failures << " checks failed, test FAILED!" << endl;
+        return -1;
+    }
+
+    cout << "\nAll PingReadPng unit tests PASSED" << endl;
+    return 0;
+}
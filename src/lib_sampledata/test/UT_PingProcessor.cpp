@@ -0,0 +1,150 @@
+//=============================================================================
+/** @file UT_PingProcessor.cpp
+ *
+ * @brief
+ *	Unit test for PingProcessor: checks its results against a plain
+ *	reference and that, once configured, processing pings never touches
+ *	the heap. Allocations are counted by replacing the global operator new.
+ *
+ * @author cmoran
+ */
+//=============================================================================
+
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <random>
+
+#include "../PingProcessor.h"
+
+using namespace std;
+
+
+#define MAX_COLS   256     // Longest ping processed
+#define NUM_PINGS  5000    // Pings processed with allocations counted
+
+static unsigned long g_allocations = 0;
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// GCC can't see that these free what the operator new above malloc'd
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+
+//=============================================================================
+int main()
+{
+    cout << "<< Testing PingProcessor >>\n" << endl;
+
+    // Pings are made before counting starts, of varying lengths
+    mt19937 rng(1234);
+    uniform_int_distribution<int> sample(0, 255);
+    uniform_int_distribution<int> length(MAX_COLS / 2, MAX_COLS);
+    vector<int> pings(NUM_PINGS * MAX_COLS);
+    vector<int> lengths(NUM_PINGS);
+    for (int p = 0; p < NUM_PINGS; p++)
+    {
+        lengths[p] = length(rng);
+        for (int c = 0; c < MAX_COLS; c++)
+        {
+            pings[p * MAX_COLS + c] = sample(rng);
+        }
+    }
+
+    PingProcessor UUT;
+    UUT.Configure(MAX_COLS, 0, 150, PING_REFINE_PARABOLIC);
+    UUT.Seed(42);
+
+    unsigned long allocationsBefore = g_allocations;
+    int failures = 0;
+    int padded = 0;
+    for (int p = 0; p < NUM_PINGS; p++)
+    {
+        const int* ping = &pings[p * MAX_COLS];
+        int cols = lengths[p];
+        PingResult result;
+        if ( !UUT.Process(ping, cols, result) )
+        {
+            failures++;
+            continue;
+        }
+
+        // The first largest sample in the window
+        int best = 0;
+        for (int c = 1; c < 150 && c < cols; c++)
+        {
+            if (ping[c] > ping[best])
+            {
+                best = c;
+            }
+        }
+        if (result.peak.index != best)
+        {
+            failures++;
+        }
+
+        // The padded copy holds the ping shifted by offset + wiggle, zeros around it
+        if (result.padded_index >= 0)
+        {
+            padded++;
+            const int* buf = UUT.Padded();
+            int start = result.offset + result.wiggle;
+            for (int k = 0; k < UUT.PaddedSize(); k++)
+            {
+                int expected = (k >= start && k < start + cols) ? ping[k - start] : 0;
+                if (buf[k] != expected)
+                {
+                    failures++;
+                    break;
+                }
+            }
+        }
+    }
+    unsigned long allocations = g_allocations - allocationsBefore;
+
+    PingResult tooLong;
+    if ( UUT.Process(&pings[0], MAX_COLS + 1, tooLong) )
+    {
+        cout << "A ping longer than MAX_COLS was accepted" << endl;
+        failures++;
+    }
+
+    cout << "Processed " << NUM_PINGS << " pings (" << padded << " padded), "
+         << allocations << " heap allocations" << endl;
+
+    if (failures > 0)
+    {
+        cout << failures << " results did not match the reference, test FAILED!" << endl;
+        return -1;
+    }
+    if (allocations != 0)
+    {
+        cout << "Processing pings allocated, test FAILED!" << endl;
+        return -2;
+    }
+
+    cout << "\nAll PingProcessor unit tests PASSED" << endl;
+    return 0;
+}
@@ -0,0 +1,284 @@
+//=============================================================================
+/** @file UT_TelemetryLog.cpp
+ *
+ * @brief
+ *	Unit test for TelemetryLog and TelemetryReader: writes a long log from
+ *	a fake clock, reads time slices back through the index, then cuts the
+ *	log short the way a killed app leaves it and reads it again through
+ *	the block headers.
+ *
+ * @author cmoran
+ */
+//=============================================================================
+
+#include <iostream>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "../TelemetryLog.h"
+
+using namespace std;
+
+
+#define NUM_TICKS     20000   // Seconds of log, one position and two maximums a second
+#define BLOCK_RECORDS 256     // Records per block
+#define START_TIME    1.5e9   // First record's time
+#define WRITERS       3       // Threads writing at once, as pIncludeSampleData does
+#define WRITER_RECORDS 5000   // Records each of them writes
+
+static double g_now = START_TIME;
+
+static double FakeClock()
+{
+    return g_now;
+}
+
+// Records of type expected in [from, to], as WriteLog() writes them
+static size_t Expected(double from, double to, int type)
+{
+    size_t n = 0;
+    for (int t = 0; t < NUM_TICKS; t++)
+    {
+        double when = START_TIME + t;
+        if (when >= from && when <= to)
+        {
+            n += (type == TLM_POSITION) ? 1 : (type == TLM_MAXIMUM) ? 2 : 3;
+        }
+    }
+    return n;
+}
+
+static bool WriteLog(const string& path, const string& killed, bool close)
+{
+    TelemetryLog log;
+    log.SetClock(FakeClock);
+    string err;
+    if ( !log.Open(path, err, BLOCK_RECORDS, 60.0) )
+    {
+        cout << err << endl;
+        return false;
+    }
+    for (int t = 0; t < NUM_TICKS; t++)
+    {
+        g_now = START_TIME + t;
+        log.Write(TLM_MAXIMUM, t % 500, 200, t % 500 + 0.25);
+        log.Write(TLM_MAXIMUM, t % 500, 201, t % 500 + 0.5);
+        log.Write(TLM_POSITION, t * 0.5, -t * 0.25, 90, t % 500, 10.5);
+    }
+    if (close)
+    {
+        log.Close();
+    }
+    else
+    {
+        // Everything but the block still in memory is on disk. A copy of
+        // it cut part way through a record, with no index, is what a killed
+        // app leaves
+        log.Write(TLM_POSITION, 1, 2, 3, 4, 5);
+        log.Flush();
+        log.Write(TLM_POSITION, 1, 2, 3, 4, 5);
+        FILE* in = fopen(path.c_str(), "rb");
+        vector<char> bytes(4 << 20);
+        size_t size = in ? fread(&bytes[0], 1, bytes.size(), in) : 0;
+        if (in)
+        {
+            fclose(in);
+        }
+        FILE* out = fopen(killed.c_str(), "wb");
+        size_t keep = size - 10 * sizeof(TelemetryRecord) - 3;
+        bool ok = out && size > 0 && size < bytes.size() && fwrite(&bytes[0], 1, keep, out) == keep;
+        if (out)
+        {
+            fclose(out);
+        }
+        return ok;
+    }
+    return true;
+}
+
+// WRITERS threads write WRITER_RECORDS records each into tiny blocks, so
+// blocks fill while the writer thread is still on the last one. Every
+// record has to come back exactly once
+static bool WriteThreads(const string& path, int block_records)
+{
+    TelemetryLog log;
+    string err;
+    if ( !log.Open(path, err, block_records, 60.0) )
+    {
+        cout << err << endl;
+        return false;
+    }
+    vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; w++)
+    {
+        writers.push_back(std::thread([&log, w]() {
+            for (int i = 0; i < WRITER_RECORDS; i++)
+            {
+                log.Write(TLM_MAXIMUM, w, i, 0);
+            }
+        }));
+    }
+    for (int w = 0; w < WRITERS; w++)
+    {
+        writers[w].join();
+    }
+    log.Close();
+
+    TelemetryReader reader;
+    vector<TelemetryRecord> records;
+    if ( !reader.Open(path, err) || !reader.Read(0, 1e300, 0, records, err) ||
+         records.size() != (size_t)WRITERS * WRITER_RECORDS )
+    {
+        cout << "Threads wrote " << records.size() << " records in blocks of " << block_records
+             << ", expected " << WRITERS * WRITER_RECORDS << endl;
+        return false;
+    }
+    vector<int> seen(WRITERS * WRITER_RECORDS, 0);
+    for (size_t r = 0; r < records.size(); r++)
+    {
+        int w = (int)records[r].values[0], i = (int)records[r].values[1];
+        if (w < 0 || w >= WRITERS || i < 0 || i >= WRITER_RECORDS || seen[w * WRITER_RECORDS + i]++)
+        {
+            cout << "Threads wrote a record twice or garbled one" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//=============================================================================
+int main()
+{
+    cout << "<< Testing TelemetryLog >>\n" << endl;
+
+    string path = "UT_TelemetryLog.tlm";
+    string killed = "UT_TelemetryLog_killed.tlm";
+    int failures = 0;
+
+    if ( !WriteLog(path, killed, true) )
+    {
+        cout << "Could not write " << path << ", test FAILED!" << endl;
+        return -1;
+    }
+
+    TelemetryReader UUT;
+    string err;
+    if ( !UUT.Open(path, err) || !UUT.Indexed() )
+    {
+        cout << "Could not read the index of " << path << ": " << err << ", test FAILED!" << endl;
+        return -1;
+    }
+    if (UUT.Records() != 3ul * NUM_TICKS || UUT.StartTime() != START_TIME ||
+        UUT.EndTime() != START_TIME + NUM_TICKS - 1)
+    {
+        cout << "Index holds " << UUT.Records() << " records, test FAILED!" << endl;
+        failures++;
+    }
+
+    // A slice from the middle, then one of a type, then the whole log
+    double from = START_TIME + 7000.5, to = START_TIME + 7100;
+    vector<TelemetryRecord> records;
+    if ( !UUT.Read(from, to, 0, records, err) || records.size() != Expected(from, to, 0) )
+    {
+        cout << "Slice read " << records.size() << " records, expected " << Expected(from, to, 0) << endl;
+        failures++;
+    }
+    for (size_t r = 0; r < records.size(); r++)
+    {
+        const TelemetryRecord& rec = records[r];
+        int t = (int)(rec.time - START_TIME);
+        bool ok = (rec.time >= from && rec.time <= to);
+        if (rec.type == TLM_POSITION)
+        {
+            ok = ok && rec.count == 5 && rec.values[0] == t * 0.5f && rec.values[1] == -t * 0.25f;
+        }
+        else
+        {
+            ok = ok && rec.type == TLM_MAXIMUM && rec.count == 3 && rec.values[0] == t % 500;
+        }
+        if (!ok)
+        {
+            failures++;
+            break;
+        }
+    }
+
+    records.clear();
+    if ( !UUT.Read(from, to, 1u << TLM_POSITION, records, err) ||
+         records.size() != Expected(from, to, TLM_POSITION) )
+    {
+        cout << "Position slice read " << records.size() << " records" << endl;
+        failures++;
+    }
+
+    records.clear();
+    if ( !UUT.Read(0, 1e300, 0, records, err) || records.size() != 3ul * NUM_TICKS )
+    {
+        cout << "Whole log read " << records.size() << " records" << endl;
+        failures++;
+    }
+    UUT.Close();
+
+    // Killed before Close(): no index, the last block cut short
+    if ( !WriteLog(path, killed, false) )
+    {
+        cout << "Could not write " << killed << ", test FAILED!" << endl;
+        return -1;
+    }
+    if ( !UUT.Open(killed, err) || UUT.Indexed() )
+    {
+        cout << "Reading a log without an index: " << err << ", test FAILED!" << endl;
+        failures++;
+    }
+    unsigned long flushed = 3ul * NUM_TICKS + 1 - 11;
+    records.clear();
+    if (UUT.Records() != flushed || !UUT.Read(0, 1e300, 0, records, err) || records.size() != flushed)
+    {
+        cout << "Scanned " << UUT.Records() << " records of a killed log, expected " << flushed << endl;
+        failures++;
+    }
+    UUT.Close();
+
+    // A block is on disk flush seconds after its first record, even if
+    // nothing else is written
+    {
+        TelemetryLog log;
+        log.SetClock(FakeClock);
+        if ( !log.Open(path, err, BLOCK_RECORDS, 0.2) )
+        {
+            cout << err << endl;
+            return -1;
+        }
+        log.Write(TLM_POSITION, 1, 2, 3, 4, 5);
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        if ( !UUT.Open(path, err) || UUT.Records() != 1 )
+        {
+            cout << "Timed flush left " << UUT.Records() << " records on disk, expected 1" << endl;
+            failures++;
+        }
+        UUT.Close();
+    }
+
+    // Several threads at once, in blocks that fill on nearly every write
+    if ( !WriteThreads(path, 2) || !WriteThreads(path, 7) )
+    {
+        failures++;
+    }
+    remove(path.c_str());
+    remove(killed.c_str());
+
+    cout << "Wrote and read " << 3 * NUM_TICKS << " records in blocks of " << BLOCK_RECORDS << endl;
+
+    if (failures > 0)
+    {
+        cout << failures << " checks failed, test FAILED!" << endl;
+        return -1;
+    }
+
+    cout << "\nAll TelemetryLog unit tests PASSED" << endl;
+    return 0;
+}
@@ -16,11 +16,15 @@
 #include <chrono>
 #include <thread>
 #include <unistd.h>
+#include <sys/stat.h>
 #include <cmath>
-#include <random>
+#include <cstdlib>
 
 #include "MBUtils.h"
 #include "IncludeSampleData.h"
+#include "PingFile.h"
+#include "PingPeak.h"
+#include "PingPipeline.h"
 // Header file for the Rust image processing function library used for the sample data -> .csv file conversion
 #include "image_to_csv_rs.h"
 
@@ -42,16 +46,77 @@ IncludeSampleData::IncludeSampleData()
 		// TO_DO: Think about making filenames specifiable in a config file
 		// Specifies the image file (of .csv format) and the output file that the data will be written to, as a check
 		// that none of our operations have messed up that file during processing
-		m_input_filename = "csv_image_import.csv";
+		m_input_filename = "synthetic_image.png";
 		m_output_filename = "output.csv";
 		// m_row/colCount will be assigned the number of rows/columns in the input image file during OnStartUp()
 		m_colCount = 0;
 		m_rowCount = 0;
+		// Meters per column of the image and at column 0, used to turn the index of the return into a distance
+		m_range_scale = 10.5/106; // dist_ideal/m_colCount
+		m_range_offset = 0;
+		m_range_scale_set = false;
+		// Columns searched for the return, and how it's refined between columns
+		m_window_start = 0;
+		m_window_end = 150;
+		m_peak_refine = PING_REFINE_PARABOLIC;
+		// Wiggle noise from a random seed, nothing recorded
+		m_noise_seed = 0;
+		m_noise_mode = NOISE_LIVE;
+		m_noise_file = "wiggle_noise.txt";
+		// No live input unless INPUT_STREAM names one
+		m_input_stream = "";
+		m_ping_slots = 8;
+		m_max_ping_samples = 4096;
+		m_drops_reported = 0;
+		// Frames in flight in the ping pipeline, and how often its latency is published
+		m_pipeline_frames = 4;
+		m_latency_interval = 10;
+		m_latency_reported = 0;
+		m_last_detection = 0;
+		// Where the debug outputs go, all on by default as they always were
+		m_log_dir = ".";
+		m_log_raw_on = true;
+		m_log_padded_on = true;
+		m_log_maximums_on = true;
+		m_log_position_on = true;
+		m_log_telemetry_on = true;
+		m_log_raw = m_log_padded = m_log_maximums = m_log_position = -1;
 		// Reads the MODE from MOOSDB, which can be used to dictate certain conditional behaviors
 		m_mode = "";
 
 }
 
+//---------------------------------------------------------
+// Destructor
+//   Notes: stops the ping pipeline, writes out whatever is still queued for the debug outputs, and reports on the live input
+
+IncludeSampleData::~IncludeSampleData()
+{
+	m_pipeline.Stop();
+	PipelineLatency latency[PIPE_STAGES];
+	m_pipeline.Latency(latency);
+	if (latency[PIPE_TOTAL].count > 0)
+		cout << "Ping latency over the last " << latency[PIPE_TOTAL].count << " pings: " << latency[PIPE_TOTAL].mean_ms
+		     << " ms mean, " << latency[PIPE_TOTAL].max_ms << " ms max" << endl;
+	if (m_stream.IsOpen()) {
+		m_stream.Close();
+		cout << "Live pings: " << m_stream.Received() << " received, " << m_stream.Dropped() << " dropped, "
+		     << m_stream.Lost() << " lost in transit, " << m_stream.Bad() << " bad records" << endl;
+	}
+	m_log.Stop();
+	if (m_telemetry.IsOpen()) {
+		m_telemetry.Close();
+		cout << "Wrote " << m_telemetry.Records() << " telemetry records" << endl;
+	}
+	if (m_pipeline.Processor().Noise().TapeEnded())
+		cout << "The wiggle noise tape ran out, later draws carried on from its seed" << endl;
+	if (m_pipeline.Processor().Noise().Rejected() > 0)
+		cout << "Rejected " << m_pipeline.Processor().Noise().Rejected()
+		     << " wiggle noise tape values outside WIGGLE_BOUNDS, drew those from the seed" << endl;
+	if (m_log.Dropped() > 0)
+		cout << "Dropped " << m_log.Dropped() << " debug output records, the writer fell behind" << endl;
+}
+
 //---------------------------------------------------------
 // Procedure: OnNewMail
 
@@ -125,210 +190,168 @@ void IncludeSampleData::RegisterVariables()
 bool IncludeSampleData::Iterate()
 {
 	cout << "m_mode = " << m_mode << endl;
-	ofstream output_file_position ("position_output.csv",ios::app);
 	// TO_DO: Once file size is known, set these indices as a fraction of mColCount to prevent breaking
 	// max_index variables are supposed to the 'best guess' as a initialized index for max returned value, to make sure we never
 	// have a null or completely wrong value in this field. See above TO_DO for making this a little more dynamic
 	int max_index = 82; // This needs to go here into order to be available during lifetimes
 										  // Estimated this value, since we don't want it to ever be unassigned
 											// TO_DO: Make this more resilient
-	int max_index_padded = 82;
+	double max_position = max_index; // max_index refined to a fraction of a column, see PingPeak.h
 	// TO_DO: Feels like this could be the place for a switch statement or other FSM pattern
 
 	if (m_mode == "ACTIVE:LINE_FOLLOWING") {
-			// Open the input and output files, output file such that values append
-			ifstream input_file (m_input_filename);
-			ofstream output_file (m_output_filename,ios::app);
-			ofstream output_file_padded ("padded_output.csv",ios::app);
-			ofstream output_file_maximums ("maximums_output.csv",ios::app);
-
-			// Opens array
-			// TO_DO: Is this actually necessary? Or should be just go straight from vect(i), declaring here instead?
-			// TO_DO: Might be adding unnecessary computation by doing this conversion ^. Check back after ping analysis methodology is finalized
-			int arr[m_colCount * m_rowCount] = {};
-			std::vector<int> vect;
-			if (input_file.is_open() && output_file.is_open() && m_iterations < m_rowCount) {
-
-				string line;
-				char delim = ',';
-				string delimiter = ",";
-
-				unsigned int row_num = 0;
-				unsigned int col_num = 0;
-				while (std::getline(input_file, line))
-				{
-					if (row_num == m_iterations) {
-						//cout << line << endl;
-						std::stringstream ss(line);
-						//std::vector<int> vect;
-
-						int i;
-						while (ss >> i)
-						{
-								// Writes non-delimiter values to the signal vector
-								vect.push_back(i);
-								if (ss.peek() == ',') {
-										ss.ignore();
-								}
-						}
-
-						for (i=0; i< vect.size(); i++) {
-								//arr[col_num + row_num*m_colCount] = vect.at(i); // If was maintaining entire array instead of one line at a time
-								arr[col_num] = vect.at(i);
-								col_num++;
-						}
-					}
-					// TO_DO: Might be unnecessarily iterating through the entire file on each run-through, possible to simplify?
-					row_num++;
-					col_num = 0;
+			// Pings are decoded, analysed and written to the output files by m_pipeline's threads (see PingPipeline.h). From
+			// an image this tick asks for the next row and waits for its detection, a fraction of a millisecond, so what's
+			// published stays on the same row as the output files. From a stream it publishes the newest detection
+			PingDetection det;
+			bool have = false;
+			if (m_stream.IsOpen())
+				have = m_pipeline.Latest(det);
+			else if (!m_pipeline.RequestRow())
+				cout << "Did NOT load the INPUT image successfully, OR passed end of file " << endl;
+			else if (!(have = m_pipeline.WaitForRow(det, 1.0)))
+				cout << "Row " << m_iterations + 1 << " of the image was not analysed within a second" << endl;
+			if (m_stream.IsOpen() && (!have || det.seq == m_last_detection)) {
+				// Nothing new from the sonar since the last tick, so there's no new distance to publish either
+				cout << "No new ping on " << m_input_stream << endl;
+				ReportPipeline();
+				return(true);
+			}
+			if (have) {
+				m_last_detection = det.seq;
+				m_colCount = det.cols;
+				if (det.result.peak.index >= 0) {
+					max_index = det.result.peak.index;
+					max_position = det.result.peak.position;
 				}
-
-				// NOTE: Here's where any operations on the line array should occur; could end up publishing resulting value
-				// Finds the maximum value of the ping for standard arr[]
-				int max = arr[0]; // First assignment of the max value and index
-				max_index = 0;
-				int j = 0;
-				int bottom_edge = 150; // This is a value at which the bottom return of the acoustic image appears
-				for (j = 0; j < bottom_edge; j++) {
-					// If the next value is larger than the existing maximum, set that and the values index to 'max' and record its index
-					if (arr[j] > max) {
-						max = arr[j];
-						max_index = j;
-					}
-				}
-
-				// Writes maximum values to file
-				output_file_maximums << max_index << "," << max << endl;
-
-				// Intermediate step of padding output and fluctuating arr[]'s locations within it
-				// Not actually going to perform operations on arr[]; prefer to leave it alone, at least while we're still in simulation
-				double pad_percentage = 0.2; // Percentage of the total number of columns we're going to pad the image array with, based on the original image's size
-			  int offset = round(pad_percentage * m_colCount / 2);
-			  int padded_size = m_colCount + (offset * 2);
-			  int padded_arr[padded_size] = {}; // Creates array with padded size
-
-				// Generates oscillation of using a random number generator
-				int bounds = 10; // sets the max and min bounds
-				random_device rd;     // used to initialise (seed) engine
-				mt19937 rng(rd());    // random-number engine used (Mersenne-Twister in this case)
-				uniform_int_distribution<int> uni(-bounds,bounds); // guaranteed unbiased; uni(min,max)
-				int wiggle = uni(rng); // assigns the generated random number to the value 'wiggle', which gets used to assign values in the padded array
-
-				// Needs to make sure the the wiggle bounding stays inside the maximum array size, so checks before assigning the values to the padded array
-				if (bounds < offset) {
-				  for (int k = 0; k < padded_size; k++) {
-				    if (k >= (offset + wiggle) && k < (offset + wiggle + m_colCount) ) {
-				        padded_arr[k] = arr[k-(offset + wiggle)];
-				    }
-				    else {
-				      padded_arr[k] = 0;
-				    }
-				  }
-
-					// Finds the max value and max value index for the padded array using the same method as the unpadded image above
-					// Finds the maximum value of the ping for the padded_arr[]
-					int max_padded = padded_arr[0]; // First assignment of the max value and index
-					max_index_padded = 0;
-					int h = 0;
-					int bottom_edge_padded = 150; // This is a value at which the bottom return of the acoustic image appears
-					for (h = 0; h < bottom_edge_padded; h++) {
-						if (padded_arr[h] > max_padded) {
-							max_padded = padded_arr[h];
-							max_index_padded = h;
-						}
-					}
-
-					// Printing padded_arr[] to file; appends row values to the end of the output file
-					for (int n = 0; n < padded_size; n++) {
-						if (n == (padded_size - 1)) {
-							output_file_padded << padded_arr[n] << "\n";
-						}
-						else {
-							output_file_padded << padded_arr[n] << ",";
-						}
-					}
-				}
-				else {
-					// If we're out of bounds, will notify us that that's the case, and write that to file. Be careful of this when
-					// setting these values in the mission before compiling
-					output_file_padded << "$bounds is less that $offset, would write out of bounds" << endl;
-					cout << "$bounds is less that $offset, would write out of bounds" << endl;
-				}
-
-
-				// Printing arr[] to file; appends row values to the end of the output file
-				for (int m = 0; m < m_colCount; m++) {
-					if (m == (m_colCount - 1)) {
-						//printf("%d \n",arr[m]);
-						output_file << arr[m] << "\n";
-
-					}
-					else {
-						//printf("%d, ",arr[m]);
-						output_file << arr[m] << ",";
-					}
-				}
-				cout << "From m_iterations, wrote row number " << m_iterations << " to file" << endl;
-
-			} else { cout << "Did NOT succesfully open INPUT or OUTPUT file successfully, OR passed end of file " << endl; }
+			}
 	m_iterations++; // Putting this INSIDE the if-statement, so that we don't end up with discontinuities in the image
 	}
 
 	cout << "Max value index is: " << max_index << endl;
-	// TO_DO: This conversion factor's NOT ACCURATE, but is chosen for convenience in the simulation for the moment
-	double conversion_factor = 10.5/106; // dist_ideal/m_colCount
-	double distance_from_pixels = max_index * conversion_factor; //
+	// TO_DO: The default conversion factor's NOT ACCURATE, but is chosen for convenience in the simulation for the moment.
+	// A ping file or RANGE_SCALE can give the real one
+	double distance_from_pixels = m_range_offset + max_position * m_range_scale;
 	Notify(m_outgoing_var,distance_from_pixels); // Writes the "distance" of the signal return (should be longline distance) to MOOSDB for pLineFollow
   //Notify(m_outgoing_var,10.5); // Can write SIM_DISTANCE == dist_ideal s.t. produces ideal behavior
 
 
 	// Writes position and heading data to file for use in post-run analytics
-	output_file_position << m_nav_x << "," << m_nav_y << ","<< m_nav_heading << "," << max_index << "," << distance_from_pixels << "," << endl;
+	if (m_log_position >= 0) {
+		m_record.clear();
+		LogAppendValue(m_record, m_nav_x, ",");
+		LogAppendValue(m_record, m_nav_y, ",");
+		LogAppendValue(m_record, m_nav_heading, ",");
+		LogAppendValue(m_record, max_index, ",");
+		LogAppendValue(m_record, distance_from_pixels, ",\n");
+		m_log.Write(m_log_position, m_record);
+	}
+	m_telemetry.Write(TLM_POSITION, m_nav_x, m_nav_y, m_nav_heading, max_index, distance_from_pixels);
 
+	ReportPipeline();
   return(true);
 }
 
 //---------------------------------------------------------
-// Procedure: OnStartUp()
-//            happens before connection is open
+// Procedure: ReportPipeline()
+//            publishes live pings that were dropped as the count changes, and every m_latency_interval seconds how long
+//            pings are taking in each stage of m_pipeline as "decode=mean/max,analyze=..,log=..,total=.." in milliseconds
 
-bool IncludeSampleData::OnStartUp()
+void IncludeSampleData::ReportPipeline()
 {
+	if (m_stream.IsOpen()) {
+		unsigned long drops = m_stream.Dropped();
+		if (drops != m_drops_reported) {
+			Notify("SAMPLE_PING_DROPS", (double)drops);
+			m_drops_reported = drops;
+		}
+	}
 
-	// Start by converting the specified image to a .csv file
-  // This process calls a Rust function from the image_to_csv_rs library
-  cout << "STARTING image->.csv file conversion using Rust binary" << endl;
-  string image_path = "./synthetic_image.png";
-  string csv_export_path = "./csv_image_import.csv";
-  int32_t image_return = process_image(image_path.c_str(),csv_export_path.c_str());
-  if (image_return == 0) {
-    cout << "Image processing in Rust function was SUCCESSFUL" << endl;
-  }
-  else {
-    cout << "Image processing in Rust function was NOT SUCESSFUL" << endl;
-  }
+	double now = MOOSTime();
+	if (m_latency_interval <= 0 || now - m_latency_reported < m_latency_interval)
+		return;
+	m_latency_reported = now;
+
+	PipelineLatency latency[PIPE_STAGES];
+	m_pipeline.Latency(latency);
+	if (latency[PIPE_TOTAL].count == 0)
+		return;
+	static const char *names[PIPE_STAGES] = {"decode", "analyze", "log", "total"};
+	char report[256];
+	int len = 0;
+	for (int s = 0; s < PIPE_STAGES; s++)
+		len += snprintf(report + len, sizeof(report) - len, "%s%s=%.3f/%.3f", (s > 0) ? "," : "", names[s],
+		                latency[s].mean_ms, latency[s].max_ms);
+	Notify("SAMPLE_PIPELINE_LATENCY", report);
+}
 
-	// Opens input file and find rowCount and colCount numbers
-	string line;
-	char delim = ','; // Both 'delim' and 'delimiter' name the type of delimter used in the csv file (could be a colon or something)
-	string delimiter = ",";
-	size_t num_of_delim;
-	ifstream input_file (m_input_filename);
-	if (input_file.is_open())   // IF we can open the file...
-  {
-    while ( getline (input_file,line) ) // ... iterate through each row until EOF and increase m_rowCount each time
-    {
-      // If we're on the first line, use the number of delimters to determine the number of columns in the file
-      if (m_rowCount == 0) {
-        num_of_delim = std::count(line.begin(), line.end(), delim);
-        m_colCount = (num_of_delim+1);
-      }
-      m_rowCount++; // Increases rowCount by 1 until the EOF
-    }
-  } else { cout << "Unable to open file"; } // Otherwise return an error saying that the file hasn't been opened
-	cout << "In OnStartUp, m_rowCount and m_colCount are " << m_rowCount << " " << m_colCount << endl;
+//---------------------------------------------------------
+// Procedure: LoadImage()
+//            reads m_input_filename into m_image and sets m_rowCount and m_colCount, returns false if it can't be read.
+//            the file is a binary ping file (see PingFile.h), a PNG image with one ping per column, or a csv image,
+//            one ping per line
+
+bool IncludeSampleData::LoadImage()
+{
+	PingFileHeader hdr;
+	string err;
+	bool ok = PingReadImage(m_input_filename, m_image, hdr, err);
+	uint32_t rows = hdr.rows, cols = hdr.cols;
+	// A ping file knows its range bins, unless the mission says otherwise
+	if (ok && hdr.range_scale > 0 && !m_range_scale_set) {
+		m_range_scale = hdr.range_scale;
+		m_range_offset = hdr.range_offset;
+	}
+
+	if (!ok) {
+		cout << err << endl;
+		m_image.clear();
+		rows = cols = 0;
+	}
+	m_rowCount = rows;
+	m_colCount = cols;
+	return(ok);
+}
+
+//---------------------------------------------------------
+// Procedure: OpenLogs()
+//            opens the debug outputs and telemetry log that are turned on in m_log_dir, creating it if needed, and starts
+//            the writer
+
+void IncludeSampleData::OpenLogs()
+{
+	if (m_log_dir == "")
+		m_log_dir = ".";
+	mkdir(m_log_dir.c_str(), 0755);   // fails harmlessly if it's already there
+	string dir = m_log_dir + "/";
+
+	if (m_log_raw_on)
+		m_log_raw = m_log.Open(dir + m_output_filename);
+	if (m_log_padded_on)
+		m_log_padded = m_log.Open(dir + "padded_output.csv");
+	if (m_log_maximums_on)
+		m_log_maximums = m_log.Open(dir + "maximums_output.csv");
+	if (m_log_position_on)
+		m_log_position = m_log.Open(dir + "position_output.csv");
+
+	if ((m_log_raw_on && m_log_raw < 0) || (m_log_padded_on && m_log_padded < 0) ||
+	    (m_log_maximums_on && m_log_maximums < 0) || (m_log_position_on && m_log_position < 0))
+		cout << "Unable to open some of the output files in " << m_log_dir << endl;
+	m_log.Start();
+
+	// Stamped with MOOSTime() so slices line up with the alogs
+	string err;
+	m_telemetry.SetClock([]() {return(MOOSTime());});
+	if (m_log_telemetry_on && !m_telemetry.Open(dir + "sample_data.tlm", err))
+		cout << "Unable to open the telemetry log: " << err << endl;
+}
 
+//---------------------------------------------------------
+// Procedure: OnStartUp()
+//            happens before connection is open
 
+bool IncludeSampleData::OnStartUp()
+{
   list<string> sParams;
   m_MissionReader.EnableVerbatimQuoting(false);
   m_MissionReader.GetConfiguration(GetAppName(), sParams);
@@ -365,8 +388,162 @@ bool IncludeSampleData::OnStartUp()
 			m_mode_received = stripBlankEnds(sLine);
 		}
 
+		// Sample image to read pings from, a binary ping file or a csv image
+		if(MOOSStrCmp(sVarName, "INPUT_FILE")) {
+				if(!strContains(sLine, " "))
+			m_input_filename = stripBlankEnds(sLine);
+		}
+
+		// Live pings from "fifo:/path", "unix:/path" or "udp:port" rather than INPUT_FILE, see ping_replay for a stand-in
+		if(MOOSStrCmp(sVarName, "INPUT_STREAM")) {
+				if(!strContains(sLine, " "))
+			m_input_stream = stripBlankEnds(sLine);
+		}
+
+		// Pings the live input can hold before the oldest is overwritten, and the longest ping it takes
+		if(MOOSStrCmp(sVarName, "PING_SLOTS")) {
+			m_ping_slots = atoi(sLine.c_str());
+		}
+
+		if(MOOSStrCmp(sVarName, "MAX_PING_SAMPLES")) {
+			m_max_ping_samples = atoi(sLine.c_str());
+		}
+
+		// Pings the pipeline can have in flight at once, and seconds between SAMPLE_PIPELINE_LATENCY reports (0 for none)
+		if(MOOSStrCmp(sVarName, "PIPELINE_FRAMES")) {
+			m_pipeline_frames = atoi(sLine.c_str());
+		}
+
+		if(MOOSStrCmp(sVarName, "LATENCY_REPORT")) {
+			m_latency_interval = atof(sLine.c_str());
+		}
+
+		// Columns [WINDOW_START, WINDOW_END) of each ping are searched for the return
+		if(MOOSStrCmp(sVarName, "WINDOW_START")) {
+			m_window_start = atoi(sLine.c_str());
+		}
+
+		if(MOOSStrCmp(sVarName, "WINDOW_END")) {
+			m_window_end = atoi(sLine.c_str());
+		}
+
+		// How the return is placed between columns: none, parabolic or centroid
+		if(MOOSStrCmp(sVarName, "PEAK_REFINE")) {
+			int refine = PingRefineFromName(tolower(stripBlankEnds(sLine)));
+			if (refine >= 0)
+				m_peak_refine = refine;
+			else
+				cout << "Unknown PEAK_REFINE " << sLine << ", using parabolic" << endl;
+		}
+
+		// Seed for the wiggle, and whether its draws are recorded to or replayed from NOISE_FILE, so runs can be repeated
+		if(MOOSStrCmp(sVarName, "NOISE_SEED")) {
+			m_noise_seed = strtoul(sLine.c_str(), NULL, 10);
+		}
+
+		if(MOOSStrCmp(sVarName, "NOISE_MODE")) {
+			int mode = NoiseModeFromName(tolower(stripBlankEnds(sLine)));
+			if (mode >= 0)
+				m_noise_mode = mode;
+			else
+				cout << "Unknown NOISE_MODE " << sLine << ", using live" << endl;
+		}
+
+		if(MOOSStrCmp(sVarName, "NOISE_FILE")) {
+				if(!strContains(sLine, " "))
+			m_noise_file = stripBlankEnds(sLine);
+		}
+
+		// Directory the debug outputs are written to, and switches for each of them
+		if(MOOSStrCmp(sVarName, "LOG_DIRECTORY")) {
+			m_log_dir = stripBlankEnds(sLine);
+		}
+
+		if(MOOSStrCmp(sVarName, "LOG_RAW")) {
+			m_log_raw_on = MOOSStrCmp(sLine, "true");
+		}
+
+		if(MOOSStrCmp(sVarName, "LOG_PADDED")) {
+			m_log_padded_on = MOOSStrCmp(sLine, "true");
+		}
+
+		if(MOOSStrCmp(sVarName, "LOG_MAXIMUMS")) {
+			m_log_maximums_on = MOOSStrCmp(sLine, "true");
+		}
+
+		if(MOOSStrCmp(sVarName, "LOG_POSITION")) {
+			m_log_position_on = MOOSStrCmp(sLine, "true");
+		}
+
+		if(MOOSStrCmp(sVarName, "LOG_TELEMETRY")) {
+			m_log_telemetry_on = MOOSStrCmp(sLine, "true");
+		}
+
+		// Meters per sample column, overrides the range scale stored in a ping file
+		if(MOOSStrCmp(sVarName, "RANGE_SCALE")) {
+			m_range_scale = atof(sLine.c_str());
+			m_range_scale_set = true;
+		}
 
   }
+
+	// Live pings replace the input file altogether
+	if (m_input_stream != "") {
+		if (m_max_ping_samples < 1)
+			m_max_ping_samples = 4096;
+		string err;
+		if (m_stream.Open(m_input_stream, m_ping_slots, m_max_ping_samples, err))
+			cout << "Reading live pings from " << m_input_stream << endl;
+		else
+			cout << "Unable to open INPUT_STREAM: " << err << endl;
+	}
+
+	// Ping files and PNG images are read directly, a csv image is first converted from the image
+  // This process calls a Rust function from the image_to_csv_rs library
+	else if (!PingIsBinary(m_input_filename) && !PingIsPng(m_input_filename)) {
+	  cout << "STARTING image->.csv file conversion using Rust binary" << endl;
+	  string image_path = "./synthetic_image.png";
+	  string csv_export_path = "./csv_image_import.csv";
+	  int32_t image_return = process_image(image_path.c_str(),csv_export_path.c_str());
+	  if (image_return == 0) {
+	    cout << "Image processing in Rust function was SUCCESSFUL" << endl;
+	  }
+	  else {
+	    cout << "Image processing in Rust function was NOT SUCESSFUL" << endl;
+	  }
+	}
+
+	// Reads the whole input file into m_image once, Iterate() then only indexes into it
+	if (m_input_stream == "" && !LoadImage()) { cout << "Unable to open file" << endl; }
+	cout << "In OnStartUp, m_rowCount and m_colCount are " << m_rowCount << " " << m_colCount << endl;
+
+	// Sizes the per-ping buffers for the longest ping there can be and seeds the wiggle once
+	PingProcessor &processor = m_pipeline.Processor();
+	processor.Configure(m_stream.IsOpen() ? m_max_ping_samples : m_colCount, m_window_start, m_window_end, m_peak_refine);
+	processor.Seed(m_noise_seed);
+	if (m_noise_mode != NOISE_LIVE) {
+		string err;
+		if (!processor.Noise().Open(m_noise_mode, m_noise_file, err))
+			cout << err << ", the wiggle won't be " << (m_noise_mode == NOISE_RECORD ? "recorded" : "replayed") << endl;
+		else
+			cout << (m_noise_mode == NOISE_RECORD ? "Recording" : "Replaying") << " the wiggle noise in " << m_noise_file << endl;
+	}
+	// Set NOISE_SEED to this to repeat the run
+	cout << "Wiggle noise seed is " << processor.Noise().Seed() << endl;
+
+	OpenLogs();
+
+	// Starts the decode, analyze and log threads
+	if (m_stream.IsOpen())
+		m_pipeline.SetStream(&m_stream);
+	else if (!m_image.empty())
+		m_pipeline.SetImage(&m_image[0], m_rowCount, m_colCount);
+	m_pipeline.SetLogs(&m_log, m_log_raw, m_log_padded, m_log_maximums);
+	if (m_telemetry.IsOpen())
+		m_pipeline.SetTelemetry(&m_telemetry);
+	m_pipeline.Start(m_pipeline_frames);
+	m_latency_reported = MOOSTime();
+
   RegisterVariables();
 
   return(true);
@@ -8,13 +8,19 @@
 #ifndef IncludeSampleData_HEADER
 #define IncludeSampleData_HEADER
 
+#include <string>
+#include <vector>
 #include "MOOS/libMOOS/MOOSLib.h"
+#include "AsyncLogWriter.h"
+#include "PingStream.h"
+#include "PingPipeline.h"
+#include "TelemetryLog.h"
 
 class IncludeSampleData : public CMOOSApp
 {
  public:
    IncludeSampleData();
-   //~IncludeSampleData(); // No need for destructor?
+   ~IncludeSampleData();
 
  protected: // Standard MOOSApp functions to overload
    bool OnNewMail(MOOSMSG_LIST &NewMail);
@@ -27,6 +33,9 @@ class IncludeSampleData : public CMOOSApp
 
  protected:
    void RegisterVariables();
+   bool LoadImage();
+   void ReportPipeline();
+   void OpenLogs();
 
  protected: // Configuration variables
      std::string m_outgoing_var;
@@ -41,6 +50,34 @@ class IncludeSampleData : public CMOOSApp
      std::string m_output_filename;
      int m_colCount;
      int m_rowCount;
+     double m_range_scale;
+     double m_range_offset;
+     bool m_range_scale_set;
+     int m_window_start;
+     int m_window_end;
+     int m_peak_refine;
+
+     // The wiggle's noise, see NoiseSource.h. A seed of 0 picks one at random
+     unsigned int m_noise_seed;
+     int m_noise_mode;
+     std::string m_noise_file;
+
+     // Live pings instead of m_input_filename when set, see PingStream.h
+     std::string m_input_stream;
+     int m_ping_slots;
+     int m_max_ping_samples;
+
+     // Frames in flight in m_pipeline, and seconds between latency reports
+     int m_pipeline_frames;
+     double m_latency_interval;
+
+     // Debug outputs, each written to its own file in m_log_dir unless turned off
+     std::string m_log_dir;
+     bool m_log_raw_on;
+     bool m_log_padded_on;
+     bool m_log_maximums_on;
+     bool m_log_position_on;
+     bool m_log_telemetry_on;
 
  protected: // State variables
      std::string m_mode;
@@ -50,6 +87,30 @@ class IncludeSampleData : public CMOOSApp
 
      unsigned long int m_iterations;
 
+     // The whole sample image, read once in OnStartUp(), row-major with m_colCount values per row
+     std::vector<int> m_image;
+
+
+     // Live input, read by m_pipeline instead of m_image when it's open
+     PingStream m_stream;
+     unsigned long m_drops_reported;
+
+     // Decodes, analyses and logs pings on its own threads, Iterate() only publishes its newest detection
+     PingPipeline m_pipeline;
+     unsigned long m_last_detection;
+     double m_latency_reported;
+
+     // Background writer for the debug outputs, the file ids are -1 for outputs that are off
+     AsyncLogWriter m_log;
+     int m_log_raw;
+     int m_log_padded;
+     int m_log_maximums;
+     int m_log_position;
+     std::string m_record; // The record being built, kept so its buffer is reused
+
+     // Binary position and maximum records with a time index, see TelemetryLog.h
+     TelemetryLog m_telemetry;
+
 };
 
 #endif
@@ -74,6 +74,27 @@ void showExampleConfigAndExit()
   blk("  AppTick   = 4                                                 ");
   blk("  CommsTick = 4                                                 ");
   blk("                                                                ");
+  blk("  INPUT_FILE  = synthetic_image.png // or a .ping or .csv file   ");
+  blk("  INPUT_STREAM = udp:5600 // live pings instead, or fifo:/path,  ");
+  blk("                           // unix:/path                        ");
+  blk("  PING_SLOTS       = 8    // live pings buffered                 ");
+  blk("  MAX_PING_SAMPLES = 4096 // longest live ping                   ");
+  blk("  PIPELINE_FRAMES  = 4  // pings in flight between the threads   ");
+  blk("  LATENCY_REPORT   = 10 // seconds between latency reports       ");
+  blk("  RANGE_SCALE = 0.099  // meters per column, default from file  ");
+  blk("  WINDOW_START = 0     // columns searched for the return        ");
+  blk("  WINDOW_END   = 150                                             ");
+  blk("  PEAK_REFINE  = parabolic  // or centroid, none                 ");
+  blk("  NOISE_SEED = 0       // wiggle seed, 0 picks one (printed)     ");
+  blk("  NOISE_MODE = live    // or record, replay the draws            ");
+  blk("  NOISE_FILE = wiggle_noise.txt                                  ");
+  blk("  LOG_DIRECTORY = .    // where the debug outputs are written    ");
+  blk("  LOG_RAW       = true // output.csv                             ");
+  blk("  LOG_PADDED    = true // padded_output.csv                      ");
+  blk("  LOG_MAXIMUMS  = true // maximums_output.csv                    ");
+  blk("  LOG_POSITION  = true // position_output.csv                    ");
+  blk("  LOG_TELEMETRY = true // sample_data.tlm, see telemetry_export  ");
+  blk("                                                                ");
   blk("}                                                               ");
   blk("                                                                ");
   exit(0);
@@ -100,6 +121,10 @@ void showInterfaceAndExit()
   blk("PUBLICATIONS:                                                   ");
   blk("------------------------------------                            ");
   blk("  Publications are determined by the node message content.      ");
+  blk("  SAMPLE_PING_DROPS = live pings that were never processed,    ");
+  blk("                      published as it changes                   ");
+  blk("  SAMPLE_PIPELINE_LATENCY = decode=0.01/0.02,analyze=..,log=..,  ");
+  blk("                      total=.. mean/max ms per ping stage        ");
   blk("                                                                ");
   exit(0);
 }
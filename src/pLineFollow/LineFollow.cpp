@@ -6,8 +6,10 @@
 /****************************************************************/
 // TO_DO: Lots of debugging code w/ 'cout' still exists. Will need to remove at
 // some point.
+#include <iostream>
 #include <iterator>
 #include <cmath>
+#include <sys/stat.h>
 #include "MBUtils.h"
 #include "LineFollow.h"
 
@@ -62,6 +64,10 @@ LineFollow::LineFollow()
 		  m_distance_averaged = 0.0;
 			m_iterations = 0;
 
+      // Writes each spawned waypoint to line_follow.tlm in LOG_DIRECTORY unless LOG_TELEMETRY = false
+      m_log_telemetry_on = true;
+      m_log_dir = ".";
+
 }
 
 //---------------------------------------------------------
@@ -213,6 +219,7 @@ bool LineFollow::Iterate()
 
 	// Writes the m_point_string to UPDATES_LINE_FOLLOWING
   Notify(m_outgoing_point,m_point_string);
+  m_telemetry.Write(TLM_WAYPOINT, m_nav_x, m_nav_y, m_nav_x + c_tfmd.x, m_nav_y + c_tfmd.y, avg_dist);
 
   return(true);
 }
@@ -274,6 +281,26 @@ bool LineFollow::OnStartUp()
 			m_line_theta_received = stripBlankEnds(sLine);
 		}
 
+    if(MOOSStrCmp(sVarName, "LOG_TELEMETRY")) {
+			m_log_telemetry_on = MOOSStrCmp(sLine, "true");
+		}
+
+    if(MOOSStrCmp(sVarName, "LOG_DIRECTORY")) {
+			m_log_dir = stripBlankEnds(sLine);
+		}
+
+  }
+
+  // Stamped with MOOSTime() so the waypoints line up with pIncludeSampleData's telemetry and the alogs. Give both apps
+  // the same LOG_DIRECTORY to keep their logs together
+  string err;
+  m_telemetry.SetClock([]() {return(MOOSTime());});
+  if(m_log_dir == "")
+    m_log_dir = ".";
+  if(m_log_telemetry_on) {
+    mkdir(m_log_dir.c_str(), 0755);   // fails harmlessly if it's already there
+    if(!m_telemetry.Open(m_log_dir + "/line_follow.tlm", err))
+      cout << "Unable to open the telemetry log: " << err << endl;
   }
 
   RegisterVariables();
@@ -9,6 +9,7 @@
 #define LineFollow_HEADER
 
 #include "MOOS/libMOOS/MOOSLib.h"
+#include "TelemetryLog.h"
 
 class LineFollow : public CMOOSApp
 {
@@ -40,6 +41,8 @@ class LineFollow : public CMOOSApp
     std::string m_incoming_distance;
     std::string m_mode_received;
     std::string m_line_theta_received;
+    bool m_log_telemetry_on;
+    std::string m_log_dir;
 
 
  protected: // State variables
@@ -58,6 +61,9 @@ class LineFollow : public CMOOSApp
      double m_distance_saved[5];
      double m_distance_averaged;
 
+     // Binary waypoint records with a time index, see TelemetryLog.h
+     TelemetryLog m_telemetry;
+
 };
 
 #endif
@@ -74,6 +74,9 @@ void showExampleConfigAndExit()
   blk("  AppTick   = 4                                                 ");
   blk("  CommsTick = 4                                                 ");
   blk("                                                                ");
+  blk("  LOG_DIRECTORY = .    // where line_follow.tlm is written       ");
+  blk("  LOG_TELEMETRY = true // line_follow.tlm, see telemetry_export  ");
+  blk("                                                                ");
   blk("}                                                               ");
   blk("                                                                ");
   exit(0);
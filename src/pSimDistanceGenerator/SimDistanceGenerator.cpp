@@ -6,7 +6,8 @@
 /****************************************************************/
 
 #include <iterator>
-#include <random>
+#include <iostream>
+#include <cstdlib>
 #include <cmath>
 #include "MBUtils.h"
 #include "SimDistanceGenerator.h"
@@ -25,6 +26,9 @@ SimDistanceGenerator::SimDistanceGenerator()
     m_nav_heading = 0.0;
     m_iterator = 0;
     m_point_string = "point = 100,0";
+    m_noise_seed = 0;
+    m_noise_mode = NOISE_LIVE;
+    m_noise_file = "range_noise.txt";
 }
 
 //---------------------------------------------------------
@@ -99,10 +103,7 @@ bool SimDistanceGenerator::Iterate()
 {
     int max = 10;
     int min = 1;
-    random_device rd;     // only used once to initialise (seed) engine
-    mt19937 rng(rd());    // random-number engine used (Mersenne-Twister in this case)
-    uniform_int_distribution<int> uni(min,max); // guaranteed unbiased
-    auto random_integer = uni(rng);
+    int random_integer = m_noise.Draw(min,max); // seeded once in OnStartUp, unbiased
     double delta = random_integer/10.0;
     m_range = 10.0 + delta;
 
@@ -160,8 +161,35 @@ bool SimDistanceGenerator::OnStartUp()
 		m_nav_heading_received = stripBlankEnds(sLine);
 	}
 
+	// Seed for the range noise, and whether its draws are recorded to or replayed from NOISE_FILE
+	if(MOOSStrCmp(sVarName, "NOISE_SEED")) {
+		m_noise_seed = strtoul(sLine.c_str(), NULL, 10);
+	}
+
+	if(MOOSStrCmp(sVarName, "NOISE_MODE")) {
+		int mode = NoiseModeFromName(tolower(stripBlankEnds(sLine)));
+		if(mode >= 0)
+			m_noise_mode = mode;
+		else
+			cout << "Unknown NOISE_MODE " << sLine << ", using live" << endl;
+	}
+
+	if(MOOSStrCmp(sVarName, "NOISE_FILE")) {
+		if(!strContains(sLine, " "))
+	m_noise_file = stripBlankEnds(sLine);
+	}
+
+
+  }
 
+  m_noise.SetSeed(m_noise_seed);
+  if(m_noise_mode != NOISE_LIVE) {
+    string err;
+    if(!m_noise.Open(m_noise_mode, m_noise_file, err))
+      cout << err << ", the range noise won't be " << (m_noise_mode == NOISE_RECORD ? "recorded" : "replayed") << endl;
   }
+  // Set NOISE_SEED to this to repeat the run
+  cout << "Range noise seed is " << m_noise.Seed() << endl;
 
   RegisterVariables();
   return(true);
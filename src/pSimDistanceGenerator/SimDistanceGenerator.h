@@ -9,6 +9,7 @@
 #define SimDistanceGenerator_HEADER
 
 #include "MOOS/libMOOS/MOOSLib.h"
+#include "NoiseSource.h"
 
 class SimDistanceGenerator : public CMOOSApp
 {
@@ -35,6 +36,11 @@ class SimDistanceGenerator : public CMOOSApp
    std::string m_nav_y_received;
    std::string m_nav_heading_received;
 
+   // The range noise, see NoiseSource.h. A seed of 0 picks one at random
+   unsigned int m_noise_seed;
+   int m_noise_mode;
+   std::string m_noise_file;
+
  protected: // State variables
   double m_range;
   double m_nav_x;
@@ -42,6 +48,7 @@ class SimDistanceGenerator : public CMOOSApp
   double m_nav_heading;
   int m_iterator;
   std::string m_point_string;
+  NoiseSource m_noise;
 
 };
 
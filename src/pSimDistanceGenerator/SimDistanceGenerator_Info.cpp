@@ -75,6 +75,9 @@ void showExampleConfigAndExit()
   blk("  CommsTick = 4                                                 ");
   blk("                                                                ");
   blk("  OUTGOING_VAR = SIM_DISTANCE                                   ");
+  blk("  NOISE_SEED   = 0     // range noise seed, 0 picks one (printed)");
+  blk("  NOISE_MODE   = live  // or record, replay the draws            ");
+  blk("  NOISE_FILE   = range_noise.txt                                 ");
   blk("}                                                               ");
   blk("                                                                ");
   exit(0);
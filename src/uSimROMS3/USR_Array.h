@@ -0,0 +1,50 @@
+//---------------------------------------------------------------------
+// USR_Array: flat array that either owns its values (filled from the
+// netCDF file, same interface as the std::vector it replaces) or points
+// at values somewhere else, e.g. a memory-mapped field cache. attached
+// arrays are read only, writing into one is an error.
+
+#ifndef USR_ARRAY_HEADER
+#define USR_ARRAY_HEADER
+
+#include <vector>
+#include <cstddef>
+
+template <class T>
+class USR_Array
+{
+public:
+  USR_Array() : m_data(NULL), m_size(0) {}
+
+  void assign(size_t n, const T &val)
+    {m_owned.assign(n, val); Own();}
+  void resize(size_t n)
+    {m_owned.resize(n); Own();}
+  void attach(const T* data, size_t n)
+    {std::vector<T>().swap(m_owned); m_data = const_cast<T*>(data); m_size = n;}
+  void release()
+    {std::vector<T>().swap(m_owned); m_data = NULL; m_size = 0;}
+
+  size_t size() const  {return(m_size);}
+  bool   empty() const {return(m_size == 0);}
+
+  T*       data()       {return(m_data);}
+  const T* data() const {return(m_data);}
+  T&       operator[](size_t i)       {return(m_data[i]);}
+  const T& operator[](size_t i) const {return(m_data[i]);}
+
+private:
+  // an owning copy would point into the other array's storage
+  USR_Array(const USR_Array&);
+  USR_Array& operator=(const USR_Array&);
+
+protected:
+  void Own() {m_data = m_owned.empty() ? NULL : &m_owned[0]; m_size = m_owned.size();}
+
+protected:
+  std::vector<T> m_owned;
+  T*             m_data;
+  size_t         m_size;
+};
+
+#endif
@@ -0,0 +1,197 @@
+//---------------------------------------------------------------------
+// USR_Batch.cpp: offline sampling of the ROMS fields along tracks, for
+// mission planning without a MOOSDB. run as
+//
+//   uSimROMS3 file.moos --batch=points.csv --out=values.csv [--threads=N]
+//
+// the uSimROMS3 block of file.moos is read exactly as it is for a live
+// run. points.csv has one "time, x, y, depth" point per line (unix
+// seconds, local grid meters, meters down), lines starting with # and a
+// header line are skipped. points of one track should be on consecutive
+// lines, each thread works through a contiguous run of points and walks
+// the grid from one point to the next.
+//
+// the output is CSV unless its name ends in .bin, in which case it is
+// columnar binary: "USRBATCH", uint32 column count, uint32 0, uint64 row
+// count, a 64 byte name per column, then each column as row count doubles.
+// the columns are time, x, y, depth and one per SCALAR_VARIABLE, points
+// that couldn't be sampled get BAD_VALUE.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <thread>
+#include "USR_MOOSApp.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// Procedure: ReadPoints
+// notes : appends each point's time, x, y and depth to the four vectors
+
+static bool ReadPoints(const string &in_file, vector<double> &time, vector<double> &x,
+		       vector<double> &y, vector<double> &depth)
+{
+  FILE* fp = fopen(in_file.c_str(), "r");
+  if(fp == NULL){
+    cout << "uSimROMS3: can't open batch input " << in_file << endl;
+    return false;
+  }
+  char line[512];
+  unsigned long line_num = 0;
+  while(fgets(line, sizeof(line), fp) != NULL){
+    line_num++;
+    char* p = line;
+    while(*p == ' ' || *p == '\t')
+      p++;
+    if(*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+      continue;
+
+    double v[4];
+    int got = 0;
+    for(; got < 4; got++){
+      char* end;
+      v[got] = strtod(p, &end);
+      if(end == p)
+	break;
+      p = end;
+      while(*p == ' ' || *p == '\t' || *p == ',')
+	p++;
+    }
+    if(got < 4){
+      if(line_num == 1)   // header
+	continue;
+      cout << "uSimROMS3: bad batch point on line " << line_num << " of " << in_file << endl;
+      fclose(fp);
+      return false;
+    }
+    time.push_back(v[0]);
+    x.push_back(v[1]);
+    y.push_back(v[2]);
+    depth.push_back(v[3]);
+  }
+  fclose(fp);
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: WriteColumns
+
+static bool WriteColumns(const string &out_file, const vector<string> &names,
+			 const vector<const double*> &cols, size_t rows)
+{
+  FILE* fp = fopen(out_file.c_str(), "wb");
+  if(fp == NULL){
+    cout << "uSimROMS3: can't write batch output " << out_file << endl;
+    return false;
+  }
+
+  bool ok = true;
+  if(strEnds(out_file, ".bin")){
+    uint32_t num_cols = cols.size(), pad = 0;
+    uint64_t num_rows = rows;
+    ok = ok && fwrite("USRBATCH", 1, 8, fp) == 8;
+    ok = ok && fwrite(&num_cols, sizeof(num_cols), 1, fp) == 1;
+    ok = ok && fwrite(&pad, sizeof(pad), 1, fp) == 1;
+    ok = ok && fwrite(&num_rows, sizeof(num_rows), 1, fp) == 1;
+    for(unsigned int c = 0; c < cols.size(); c++){
+      char name[64] = {0};
+      strncpy(name, names[c].c_str(), sizeof(name) - 1);
+      ok = ok && fwrite(name, 1, sizeof(name), fp) == sizeof(name);
+    }
+    for(unsigned int c = 0; ok && c < cols.size(); c++)
+      ok = (rows == 0) || fwrite(cols[c], sizeof(double), rows, fp) == rows;
+  }
+  else{
+    for(unsigned int c = 0; c < cols.size(); c++)
+      fprintf(fp, "%s%s", (c == 0) ? "" : ",", names[c].c_str());
+    fprintf(fp, "\n");
+    for(size_t r = 0; ok && r < rows; r++){
+      fprintf(fp, "%.3f", cols[0][r]);
+      for(unsigned int c = 1; c < cols.size(); c++)
+	fprintf(fp, ",%.9g", cols[c][r]);
+      ok = (fprintf(fp, "\n") == 1);
+    }
+  }
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok)
+    cout << "uSimROMS3: error writing batch output " << out_file << endl;
+  return ok;
+}
+
+//---------------------------------------------------------------------
+// Procedure: RunBatch
+// notes : loads the fields the same way OnStartUp() does, then samples every point in in_file on threads
+//         threads (all cores if 0 or less) and writes the values to out_file. returns false on any error
+
+bool USR_MOOSApp::RunBatch(string mission_file, string app_name, string in_file, string out_file, int threads)
+{
+  m_MissionReader.SetFile(mission_file);
+  m_MissionReader.SetAppName(app_name);
+  if(!Configure(app_name))
+    return false;
+  if(stream_field)
+    cout << "uSimROMS3: warning: STREAM_FIELD is set, points that jump around in time will be slow" << endl;
+  if(tile_field)
+    cout << "uSimROMS3: warning: TILE_FIELD is set, points that jump around the grid will be slow" << endl;
+
+  vector<double> p_time, p_x, p_y, p_depth;
+  if(!ReadPoints(in_file, p_time, p_x, p_y, p_depth))
+    return false;
+  size_t rows = p_time.size();
+
+  if(threads <= 0)
+    threads = thread::hardware_concurrency();
+  if(threads <= 0)
+    threads = 1;
+  if((size_t)threads > rows)
+    threads = (rows > 0) ? rows : 1;
+
+  //one column per variable, so each thread writes its own run of every column
+  vector<double> results(rows * NumVars(), bad_val);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  vector<thread> workers;
+  vector<unsigned long> failed(threads, 0);
+  for(int t = 0; t < threads; t++){
+    size_t first = rows * t / threads;
+    size_t last  = rows * (t + 1) / threads;
+    workers.push_back(thread([&, t, first, last](){
+	  USR_Query q;
+	  vector<double> values(NumVars());
+	  for(size_t r = first; r < last; r++){
+	    q.time  = p_time[r];
+	    q.x     = p_x[r];
+	    q.y     = p_y[r];
+	    q.depth = p_depth[r];
+	    if(!Sample(q, &values[0])){
+	      failed[t]++;
+	      continue;
+	    }
+	    for(int v = 0; v < NumVars(); v++)
+	      results[v * rows + r] = values[v];
+	  }
+	}));
+  }
+  unsigned long num_failed = 0;
+  for(int t = 0; t < threads; t++){
+    workers[t].join();
+    num_failed += failed[t];
+  }
+
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "uSimROMS3: sampled " << rows << " points on " << threads << " threads in " << secs << " s ("
+       << rows / max(secs, 1e-9) << " points/s), " << num_failed << " off the grid or on land" << endl;
+
+  vector<string> names;
+  vector<const double*> cols;
+  names.push_back("time");   cols.push_back(rows ? &p_time[0] : NULL);
+  names.push_back("x");      cols.push_back(rows ? &p_x[0] : NULL);
+  names.push_back("y");      cols.push_back(rows ? &p_y[0] : NULL);
+  names.push_back("depth");  cols.push_back(rows ? &p_depth[0] : NULL);
+  for(int v = 0; v < NumVars(); v++){
+    names.push_back(scalarOutputVars[v]);
+    cols.push_back(rows ? &results[v * rows] : NULL);
+  }
+  return WriteColumns(out_file, names, cols, rows);
+}
@@ -0,0 +1,405 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
+#include <chrono>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include "USR_MOOSApp.h"
+#include "USR_FieldCache.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// Procedure: JoinNames
+
+static string JoinNames(const vector<string> &names)
+{
+  string joined;
+  for(unsigned int i = 0; i < names.size(); i++)
+    joined += (i == 0 ? "" : ",") + names[i];
+  return(joined);
+}
+
+//---------------------------------------------------------------------
+// Procedure: GridNames
+// notes : the names of the variables the grid, time and s values come from, as kept in a cache header
+
+string USR_MOOSApp::GridNames() const
+{
+  const string names[] = {latVarName, lonVarName, maskRhoVarName, bathyVarName, timeVarName, sVarName};
+  return(JoinNames(vector<string>(names, names + 6)));
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_MappedFile::Map
+
+bool USR_MappedFile::Map(const string &path, bool shm)
+{
+  Unmap();
+  int fd = shm ? shm_open(path.c_str(), O_RDONLY, 0) : open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0){
+    close(fd);
+    return false;
+  }
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);   // the mapping keeps the file open
+  if(addr == MAP_FAILED)
+    return false;
+
+  m_data = (const char*)addr;
+  m_size = st.st_size;
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_MappedFile::Unmap
+
+void USR_MappedFile::Unmap()
+{
+  if(m_data != NULL)
+    munmap((void*)m_data, m_size);
+  m_data = NULL;
+  m_size = 0;
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_MappedFile::Swap
+
+void USR_MappedFile::Swap(USR_MappedFile &other)
+{
+  swap(m_data, other.m_data);
+  swap(m_size, other.m_size);
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_FileStamp
+
+bool USR_FileStamp(const string &path, int64_t &size, int64_t &mtime)
+{
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0)
+    return false;
+  size  = st.st_size;
+  mtime = st.st_mtime;
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: LoadFieldCache
+// notes : maps the field cache file (or shared memory object if shm is set) called name and points the field
+//         and grid arrays into it. returns false (and leaves everything alone) if the cache is missing or was
+//         built from a different file, variables, origin, FAST_CONVERT setting or grid size, in which case the
+//         caller falls back to ReadNcFile(). missing, if given, is set when there is no cache yet or it is still
+//         being written
+
+bool USR_MOOSApp::LoadFieldCache(const string &name, bool shm, bool* missing)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  string what = shm ? "shared field" : "field cache";
+  if(missing != NULL)
+    *missing = false;
+
+  int64_t src_size, src_mtime;
+  if(!USR_FileStamp(ncFileName, src_size, src_mtime)){
+    cout << "uSimROMS3: can't stat " << ncFileName << ", not using the " << what << endl;
+    return false;
+  }
+  USR_MappedFile image;
+  const char zero_magic[8] = {0};
+  if(!image.Map(name, shm) ||
+     (image.Size() >= sizeof(USR_CacheHeader) && memcmp(image.Data(), zero_magic, 8) == 0)){
+    if(missing != NULL)
+      *missing = true;
+    else
+      cout << "uSimROMS3: no " << what << " at " << name << endl;
+    return false;
+  }
+
+  const USR_CacheHeader* hdr = (const USR_CacheHeader*)image.Data();
+  string reason;
+  if(image.Size() < sizeof(USR_CacheHeader) || memcmp(hdr->magic, USR_CACHE_MAGIC, 8) != 0)
+    reason = "not a field cache";
+  else if(hdr->version != USR_CACHE_VERSION || hdr->header_bytes != sizeof(USR_CacheHeader))
+    reason = "old cache version";
+  else if(hdr->value_bytes != (single_precision ? sizeof(float) : sizeof(double)))
+    reason = "SINGLE_PRECISION has changed";
+  else if(hdr->src_size != src_size || hdr->src_mtime != src_mtime)
+    reason = ncFileName + " has changed";
+  else if(hdr->lat_origin != lat_origin || hdr->long_origin != long_origin)
+    reason = "LatOrigin/LongOrigin have changed";
+  else if(JoinNames(varNames) != string(hdr->var_names, strnlen(hdr->var_names, sizeof(hdr->var_names))))
+    reason = "built for different variables";
+  else if(GridNames() != string(hdr->grid_names, strnlen(hdr->grid_names, sizeof(hdr->grid_names))))
+    reason = "built from different grid, time or depth variables";
+  else if(hdr->fast_convert != (fast_convert ? 1u : 0u) || (fast_convert && hdr->convert_tol != convert_tol))
+    reason = "FAST_CONVERT/CONVERT_TOLERANCE have changed";
+  else if((time_override && hdr->time_vals != time_vals) || (s_override && hdr->s_rho != s_rho) ||
+	  (eta_override && hdr->eta_rho != eta_rho) || (xi_override && hdr->xi_rho != xi_rho))
+    reason = "grid size overrides don't match";
+  for(int a = 0; reason == "" && a < USR_CACHE_ARRAYS; a++){
+    if(hdr->offset[a] + hdr->bytes[a] > image.Size())
+      reason = "truncated";
+  }
+  if(reason != ""){
+    cout << "uSimROMS3: ignoring " << what << " " << name << ": " << reason << endl;
+    return false;
+  }
+
+  time_vals = hdr->time_vals;
+  s_rho     = hdr->s_rho;
+  eta_rho   = hdr->eta_rho;
+  xi_rho    = hdr->xi_rho;
+
+  const char* base = image.Data();
+  if(single_precision)
+    vals_f.attach((const float*)(base + hdr->offset[USR_CACHE_VALS]), ValIndex(time_vals, 0, 0, 0, 0));
+  else
+    vals.attach((const double*)(base + hdr->offset[USR_CACHE_VALS]), ValIndex(time_vals, 0, 0, 0, 0));
+  time.attach((const double*)(base + hdr->offset[USR_CACHE_TIME]), time_vals);
+  s_values.attach((const double*)(base + hdr->offset[USR_CACHE_S]), s_rho);
+  lat.attach((const double*)(base + hdr->offset[USR_CACHE_LAT]), Cell(eta_rho, 0));
+  lon.attach((const double*)(base + hdr->offset[USR_CACHE_LON]), Cell(eta_rho, 0));
+  meters_n.attach((const double*)(base + hdr->offset[USR_CACHE_NORTH]), Cell(eta_rho, 0));
+  meters_e.attach((const double*)(base + hdr->offset[USR_CACHE_EAST]), Cell(eta_rho, 0));
+  maskRho.attach((const int*)(base + hdr->offset[USR_CACHE_MASK]), Cell(eta_rho, 0));
+  bathy.attach((const double*)(base + hdr->offset[USR_CACHE_BATHY]), Cell(eta_rho, 0));
+
+  field_cache.Swap(image);  //the old mapping, if any, goes with image
+  field_cache_name = name;
+
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "uSimROMS3: mapped " << what << " " << name << " (" << field_cache.Size() / 1e6
+       << " MB, " << time_vals << "x" << s_rho << "x" << eta_rho << "x" << xi_rho << ") in "
+       << secs * 1000 << " ms" << endl;
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: WriteFieldImage
+// notes : writes the loaded field and grids to fp in the cache layout, bytes gets the total size. the magic is
+//         left zero unless ready is set. when streaming, the field is copied over one time slice at a time
+
+static bool writePadded(FILE* fp, const void* data, uint64_t bytes, uint64_t &offset)
+{
+  if(bytes > 0 && fwrite(data, 1, bytes, fp) != bytes)
+    return false;
+  offset += bytes;
+  static const char zeros[64] = {0};
+  while(offset % 64 != 0){
+    uint64_t n = min<uint64_t>(64 - offset % 64, sizeof(zeros));
+    if(fwrite(zeros, 1, n, fp) != n)
+      return false;
+    offset += n;
+  }
+  return true;
+}
+
+bool USR_MOOSApp::WriteFieldImage(FILE* fp, bool ready, uint64_t &bytes)
+{
+  USR_CacheHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  if(ready)
+    memcpy(hdr.magic, USR_CACHE_MAGIC, 8);
+  hdr.version      = USR_CACHE_VERSION;
+  hdr.header_bytes = sizeof(USR_CacheHeader);
+  hdr.value_bytes  = single_precision ? sizeof(float) : sizeof(double);
+  if(!USR_FileStamp(ncFileName, hdr.src_size, hdr.src_mtime))
+    return false;
+  hdr.lat_origin  = lat_origin;
+  hdr.long_origin = long_origin;
+  string names = JoinNames(varNames);
+  if(names.size() >= sizeof(hdr.var_names)){
+    cout << "uSimROMS3: too many variable names to fit in a field cache, not writing one" << endl;
+    return false;
+  }
+  strncpy(hdr.var_names, names.c_str(), sizeof(hdr.var_names) - 1);
+  string grid_names = GridNames();
+  if(grid_names.size() >= sizeof(hdr.grid_names)){
+    cout << "uSimROMS3: grid variable names too long to fit in a field cache, not writing one" << endl;
+    return false;
+  }
+  strncpy(hdr.grid_names, grid_names.c_str(), sizeof(hdr.grid_names) - 1);
+  hdr.fast_convert = fast_convert ? 1 : 0;
+  hdr.convert_tol  = convert_tol;
+  hdr.time_vals = time_vals;
+  hdr.s_rho     = s_rho;
+  hdr.eta_rho   = eta_rho;
+  hdr.xi_rho    = xi_rho;
+
+  size_t cells = Cell(eta_rho, 0);
+  hdr.bytes[USR_CACHE_VALS]  = ValIndex(time_vals, 0, 0, 0, 0) * hdr.value_bytes;
+  hdr.bytes[USR_CACHE_TIME]  = time_vals * sizeof(double);
+  hdr.bytes[USR_CACHE_S]     = s_rho * sizeof(double);
+  hdr.bytes[USR_CACHE_LAT]   = cells * sizeof(double);
+  hdr.bytes[USR_CACHE_LON]   = cells * sizeof(double);
+  hdr.bytes[USR_CACHE_NORTH] = cells * sizeof(double);
+  hdr.bytes[USR_CACHE_EAST]  = cells * sizeof(double);
+  hdr.bytes[USR_CACHE_MASK]  = cells * sizeof(int32_t);
+  hdr.bytes[USR_CACHE_BATHY] = cells * sizeof(double);
+  uint64_t offset = USR_CACHE_ALIGN;
+  for(int a = 0; a < USR_CACHE_ARRAYS; a++){
+    hdr.offset[a] = offset;
+    offset += (hdr.bytes[a] + 63) / 64 * 64;
+  }
+
+  vector<char> header_block(USR_CACHE_ALIGN, 0);
+  memcpy(&header_block[0], &hdr, sizeof(hdr));
+  bool ok = (fwrite(&header_block[0], 1, USR_CACHE_ALIGN, fp) == USR_CACHE_ALIGN);
+
+  offset = USR_CACHE_ALIGN;
+  if(single_precision)
+    ok = ok && writePadded(fp, vals_f.data(), hdr.bytes[USR_CACHE_VALS], offset);
+  else if(!stream_field)
+    ok = ok && writePadded(fp, vals.data(), hdr.bytes[USR_CACHE_VALS], offset);
+  else{
+    uint64_t slice_bytes = ValIndex(1, 0, 0, 0, 0) * sizeof(double);
+    for(int n = 0; ok && n < time_vals; n++){
+      USR_SlicePtr slice = slice_cache.Get(n);
+      ok = slice && fwrite(&(*slice)[0], 1, slice_bytes, fp) == slice_bytes;
+    }
+    offset += hdr.bytes[USR_CACHE_VALS];
+    ok = ok && writePadded(fp, NULL, 0, offset);
+  }
+  ok = ok && writePadded(fp, time.data(), hdr.bytes[USR_CACHE_TIME], offset);
+  ok = ok && writePadded(fp, s_values.data(), hdr.bytes[USR_CACHE_S], offset);
+  ok = ok && writePadded(fp, lat.data(), hdr.bytes[USR_CACHE_LAT], offset);
+  ok = ok && writePadded(fp, lon.data(), hdr.bytes[USR_CACHE_LON], offset);
+  ok = ok && writePadded(fp, meters_n.data(), hdr.bytes[USR_CACHE_NORTH], offset);
+  ok = ok && writePadded(fp, meters_e.data(), hdr.bytes[USR_CACHE_EAST], offset);
+  ok = ok && writePadded(fp, maskRho.data(), hdr.bytes[USR_CACHE_MASK], offset);
+  ok = ok && writePadded(fp, bathy.data(), hdr.bytes[USR_CACHE_BATHY], offset);
+  bytes = offset;
+  return ok;
+}
+
+//---------------------------------------------------------------------
+// Procedure: SaveFieldCache
+// notes : writes field_cache_file for the next launch. written to a temporary file first and renamed into
+//         place, so a simulator starting at the same time never maps half a cache
+
+bool USR_MOOSApp::SaveFieldCache()
+{
+  string tmp_name = field_cache_file + ".tmp";
+  FILE* fp = fopen(tmp_name.c_str(), "wb");
+  if(fp == NULL){
+    cout << "uSimROMS3: can't write field cache " << tmp_name << endl;
+    return false;
+  }
+  uint64_t bytes = 0;
+  bool ok = WriteFieldImage(fp, true, bytes);
+  ok = (fclose(fp) == 0) && ok;
+
+  if(!ok || rename(tmp_name.c_str(), field_cache_file.c_str()) != 0){
+    cout << "uSimROMS3: error writing field cache " << field_cache_file << endl;
+    remove(tmp_name.c_str());
+    return false;
+  }
+  cout << "uSimROMS3: wrote field cache " << field_cache_file << " (" << bytes / 1e6 << " MB)" << endl;
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_OwnSharedField, USR_UnlinkSharedField
+// notes : the name is kept in a plain buffer so the signal handler only calls shm_unlink, signal and raise.
+//         a shared field is a whole field's worth of RAM that would otherwise stay until reboot
+
+static char owned_shm[256] = {0};
+
+static void unlinkOwnedShm()
+{
+  if(owned_shm[0] != 0)
+    shm_unlink(owned_shm);
+  owned_shm[0] = 0;
+}
+
+static void unlinkOwnedShmAndDie(int sig)
+{
+  unlinkOwnedShm();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+void USR_OwnSharedField(const string &name)
+{
+  static bool registered = false;
+  strncpy(owned_shm, name.c_str(), sizeof(owned_shm) - 1);
+  if(!registered)
+    atexit(unlinkOwnedShm);
+  registered = true;
+  signal(SIGINT, unlinkOwnedShmAndDie);
+  signal(SIGTERM, unlinkOwnedShmAndDie);
+  signal(SIGHUP, unlinkOwnedShmAndDie);
+}
+
+void USR_UnlinkSharedField()
+{
+  unlinkOwnedShm();
+}
+
+//---------------------------------------------------------------------
+// Procedure: ServeSharedField
+// notes : copies the loaded field and grids into the shared memory object shared_field, replacing any stale
+//         one, then maps it back so this instance doesn't hold a second copy. the object is removed again when
+//         this instance exits, including when it is stopped by a signal (see USR_OwnSharedField). clients that
+//         attached keep their mapping until they exit
+
+bool USR_MOOSApp::ServeSharedField()
+{
+  shm_unlink(shared_field.c_str());
+  int fd = shm_open(shared_field.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  FILE* fp = (fd < 0) ? NULL : fdopen(fd, "wb");
+  if(fp == NULL){
+    cout << "uSimROMS3: can't create shared field " << shared_field << endl;
+    if(fd >= 0)
+      close(fd);
+    return false;
+  }
+  shared_owner = true;
+  USR_OwnSharedField(shared_field);
+
+  //the magic goes in last, a client seeing it knows the rest is there
+  uint64_t bytes = 0;
+  bool ok = WriteFieldImage(fp, false, bytes) && (fflush(fp) == 0);
+  ok = ok && (pwrite(fd, USR_CACHE_MAGIC, 8, 0) == 8);
+  ok = (fclose(fp) == 0) && ok;
+  if(!ok){
+    cout << "uSimROMS3: error writing shared field " << shared_field << endl;
+    return false;
+  }
+  cout << "uSimROMS3: serving shared field " << shared_field << " (" << bytes / 1e6 << " MB)" << endl;
+  return LoadFieldCache(shared_field, true);
+}
+
+//---------------------------------------------------------------------
+// Procedure: AttachSharedField
+// notes : maps shared_field if a server has published it. a client waits up to shared_wait seconds for the
+//         server to finish loading, a server doesn't wait and builds the field itself if there is no usable
+//         one. returns false if the caller has to load the field itself
+
+bool USR_MOOSApp::AttachSharedField()
+{
+  chrono::steady_clock::time_point give_up = chrono::steady_clock::now() +
+    chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(shared_wait));
+  bool missing = false;
+  bool told = false;
+  while(!LoadFieldCache(shared_field, true, &missing)){
+    if(!missing || field_server || chrono::steady_clock::now() >= give_up){
+      if(missing)
+	cout << "uSimROMS3: no shared field " << shared_field << " to attach to" << endl;
+      return false;
+    }
+    if(!told){
+      cout << "uSimROMS3: waiting up to " << shared_wait << " s for shared field " << shared_field << endl;
+      told = true;
+    }
+    this_thread::sleep_for(chrono::milliseconds(250));
+  }
+  return true;
+}
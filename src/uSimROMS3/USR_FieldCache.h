@@ -0,0 +1,105 @@
+//---------------------------------------------------------------------
+// USR_FieldCache: on-disk copy of everything uSimROMS3 builds at startup
+// (the scalar field, time and s values, lat/lon, local meters, mask and
+// bathymetry) so later launches can mmap it instead of re-reading the
+// netCDF file and re-running ConvertToMeters(). simulators on the same
+// host mapping the same cache share one copy in the page cache.
+//
+// the same image can also live in a POSIX shared memory object (see
+// SHARED_FIELD), written by one FIELD_SERVER instance and mapped by every
+// other simulator on the host. its magic is only filled in once the rest
+// of the image is written, a zero magic means it isn't ready yet.
+//
+// layout: a USR_CacheHeader padded to USR_CACHE_ALIGN bytes, followed by
+// each array at the byte offset recorded in the header. values are
+// stored in the host's native byte order, a cache is not meant to move
+// between machines.
+
+#ifndef USR_FIELDCACHE_HEADER
+#define USR_FIELDCACHE_HEADER
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+#define USR_CACHE_MAGIC   "USRCACHE"
+#define USR_CACHE_VERSION 4
+#define USR_CACHE_ALIGN   4096
+
+enum USR_CacheArray {
+  USR_CACHE_VALS = 0,  // double or float (time, var, s, eta, xi)
+  USR_CACHE_TIME,      // double time, unix epoch
+  USR_CACHE_S,         // double s
+  USR_CACHE_LAT,       // double (eta, xi)
+  USR_CACHE_LON,       // double (eta, xi)
+  USR_CACHE_NORTH,     // double (eta, xi)
+  USR_CACHE_EAST,      // double (eta, xi)
+  USR_CACHE_MASK,      // int32 (eta, xi)
+  USR_CACHE_BATHY,     // double (eta, xi)
+  USR_CACHE_ARRAYS
+};
+
+struct USR_CacheHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_bytes;  // sizeof(USR_CacheHeader) when written
+  uint32_t value_bytes;   // 8, or 4 for a SINGLE_PRECISION field
+  uint32_t reserved;
+
+  // the cache is only used if these still match the source file, the
+  // variables it was read from and how the grid was put into meters
+  int64_t  src_size;
+  int64_t  src_mtime;
+  double   lat_origin;
+  double   long_origin;
+  char     var_names[256]; // SCALAR_VARIABLE list, comma separated
+  char     grid_names[256]; // LAT, LON, MASK, BATHY, TIME and DEPTH_VARIABLE, comma separated
+  uint32_t fast_convert;   // FAST_CONVERT
+  uint32_t reserved2;
+  double   convert_tol;    // CONVERT_TOLERANCE, only checked with FAST_CONVERT
+
+  int32_t  time_vals;
+  int32_t  s_rho;
+  int32_t  eta_rho;
+  int32_t  xi_rho;
+
+  uint64_t offset[USR_CACHE_ARRAYS];
+  uint64_t bytes[USR_CACHE_ARRAYS];
+};
+
+//---------------------------------------------------------------------
+// read-only shared mapping of a whole file, or of a POSIX shared memory
+// object if shm is set
+
+class USR_MappedFile
+{
+public:
+  USR_MappedFile() : m_data(NULL), m_size(0) {}
+  ~USR_MappedFile() {Unmap();}
+
+  bool Map(const std::string &path, bool shm = false);
+  void Unmap();
+  void Swap(USR_MappedFile &other);
+
+  const char* Data() const {return(m_data);}
+  size_t      Size() const {return(m_size);}
+
+private:
+  USR_MappedFile(const USR_MappedFile&);
+  USR_MappedFile& operator=(const USR_MappedFile&);
+
+  const char* m_data;
+  size_t      m_size;
+};
+
+// size and modification time of a file, false if it can't be stat'ed
+bool USR_FileStamp(const std::string &path, int64_t &size, int64_t &mtime);
+
+// makes sure the shared memory object name is removed however the process
+// ends: on exit, or on SIGINT, SIGTERM or SIGHUP (which then still end it).
+// USR_UnlinkSharedField() removes it now and forgets it
+void USR_OwnSharedField(const std::string &name);
+void USR_UnlinkSharedField();
+
+#endif
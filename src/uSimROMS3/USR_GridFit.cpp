@@ -0,0 +1,162 @@
+//---------------------------------------------------------------------
+// USR_GridFit.cpp
+
+#include <cmath>
+#include <algorithm>
+#include "USR_GridFit.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// Procedure: Solve
+// notes : solves the n x n system a x = b in place (b gets x) with
+//         partial pivoting, false if it is singular
+
+static bool Solve(vector<double> &a, double* b, int n)
+{
+  for(int c = 0; c < n; c++){
+    int p = c;
+    for(int r = c + 1; r < n; r++)
+      if(fabs(a[r * n + c]) > fabs(a[p * n + c]))
+	p = r;
+    if(fabs(a[p * n + c]) < 1e-300)
+      return(false);
+    for(int k = 0; k < n; k++)
+      swap(a[c * n + k], a[p * n + k]);
+    swap(b[c], b[p]);
+
+    for(int r = 0; r < n; r++){
+      if(r == c)
+	continue;
+      double f = a[r * n + c] / a[c * n + c];
+      for(int k = c; k < n; k++)
+	a[r * n + k] -= f * a[c * n + k];
+      b[r] -= f * b[c];
+    }
+  }
+  for(int c = 0; c < n; c++)
+    b[c] /= a[c * n + c];
+  return(true);
+}
+
+//---------------------------------------------------------------------
+// Constructor
+
+USR_GridFit::USR_GridFit()
+{
+  m_lat0 = 0;
+  m_lon0 = 0;
+  m_inv_lat = 1;
+  m_inv_lon = 1;
+  for(int t = 0; t < USR_FIT_TERMS; t++){
+    m_north[t] = 0;
+    m_east[t]  = 0;
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: Terms
+// notes : u^a v^b for a + b <= degree, u and v the scaled offsets
+
+void USR_GridFit::Terms(double lat, double lon, double t[USR_FIT_TERMS]) const
+{
+  double u = (lat - m_lat0) * m_inv_lat;
+  double v = (lon - m_lon0) * m_inv_lon;
+  int n = 0;
+  double up = 1;
+  for(int a = 0; a <= USR_FIT_DEGREE; a++){
+    double vp = 1;
+    for(int b = 0; b <= USR_FIT_DEGREE - a; b++){
+      t[n++] = up * vp;
+      vp *= v;
+    }
+    up *= u;
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: Fit
+// notes : least squares through the normal equations, the offsets are
+//         scaled to [-1, 1] so they stay well conditioned
+
+bool USR_GridFit::Fit(const double* lat, const double* lon, const vector<size_t> &sample,
+		      double lat0, double lon0, Exact exact)
+{
+  m_lat0 = lat0;
+  m_lon0 = lon0;
+  double max_lat = 0, max_lon = 0;
+  for(unsigned int s = 0; s < sample.size(); s++){
+    max_lat = max(max_lat, fabs(lat[sample[s]] - lat0));
+    max_lon = max(max_lon, fabs(lon[sample[s]] - lon0));
+  }
+  m_inv_lat = (max_lat > 0) ? 1 / max_lat : 1;
+  m_inv_lon = (max_lon > 0) ? 1 / max_lon : 1;
+
+  vector<double> ata(USR_FIT_TERMS * USR_FIT_TERMS, 0);
+  double atn[USR_FIT_TERMS] = {0};
+  double ate[USR_FIT_TERMS] = {0};
+  double t[USR_FIT_TERMS];
+  for(unsigned int s = 0; s < sample.size(); s++){
+    double north, east;
+    exact(lat[sample[s]], lon[sample[s]], north, east);
+    Terms(lat[sample[s]], lon[sample[s]], t);
+    for(int r = 0; r < USR_FIT_TERMS; r++){
+      for(int c = 0; c < USR_FIT_TERMS; c++)
+	ata[r * USR_FIT_TERMS + c] += t[r] * t[c];
+      atn[r] += t[r] * north;
+      ate[r] += t[r] * east;
+    }
+  }
+
+  vector<double> ata_copy = ata;
+  if(!Solve(ata, atn, USR_FIT_TERMS) || !Solve(ata_copy, ate, USR_FIT_TERMS))
+    return(false);
+  for(int r = 0; r < USR_FIT_TERMS; r++){
+    m_north[r] = atn[r];
+    m_east[r]  = ate[r];
+  }
+  return(true);
+}
+
+//---------------------------------------------------------------------
+// Procedure: MaxError
+
+double USR_GridFit::MaxError(const double* lat, const double* lon, const vector<size_t> &check,
+			     Exact exact) const
+{
+  double max_err = 0;
+  double north, east, fit_n, fit_e;
+  for(unsigned int c = 0; c < check.size(); c++){
+    exact(lat[check[c]], lon[check[c]], north, east);
+    Convert(&lat[check[c]], &lon[check[c]], 1, &fit_n, &fit_e);
+    max_err = max(max_err, hypot(fit_n - north, fit_e - east));
+  }
+  return(max_err);
+}
+
+//---------------------------------------------------------------------
+// Procedure: Convert
+// notes : same terms as Terms(), written out with fixed loop bounds and
+//         no calls so the loop over points vectorizes
+
+void USR_GridFit::Convert(const double* lat, const double* lon, size_t n, double* north, double* east) const
+{
+  for(size_t p = 0; p < n; p++){
+    double u = (lat[p] - m_lat0) * m_inv_lat;
+    double v = (lon[p] - m_lon0) * m_inv_lon;
+    double sum_n = 0, sum_e = 0;
+    double up = 1;
+    int t = 0;
+    for(int a = 0; a <= USR_FIT_DEGREE; a++){
+      double vp = up;
+      for(int b = 0; b <= USR_FIT_DEGREE - a; b++){
+	sum_n += m_north[t] * vp;
+	sum_e += m_east[t] * vp;
+	vp *= v;
+	t++;
+      }
+      up *= u;
+    }
+    north[p] = sum_n;
+    east[p]  = sum_e;
+  }
+}
@@ -0,0 +1,51 @@
+//---------------------------------------------------------------------
+// USR_GridFit: fast lat/lon to local meters conversion for a whole ROMS
+// grid. north and east are fitted as degree 4 polynomials of the lat/lon
+// offset from the origin, by least squares against the exact conversion
+// at a sample of grid points. over the few degrees a ROMS grid covers
+// this reproduces a local tangent plane conversion to millimeters, and
+// Convert() is plain arithmetic the compiler can vectorize.
+
+#ifndef USR_GRIDFIT_HEADER
+#define USR_GRIDFIT_HEADER
+
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+#define USR_FIT_DEGREE 4
+#define USR_FIT_TERMS  15  // (degree + 1) * (degree + 2) / 2
+
+class USR_GridFit
+{
+public:
+  // the conversion being fitted, e.g. CMOOSGeodesy::LatLong2LocalGrid
+  typedef std::function<void(double lat, double lon, double &north, double &east)> Exact;
+
+  USR_GridFit();
+
+  // fits to exact at the points sample[] of the lat/lon arrays. returns
+  // false if the points don't pin the polynomial down (e.g. all on a line)
+  bool Fit(const double* lat, const double* lon, const std::vector<size_t> &sample,
+	   double lat0, double lon0, Exact exact);
+
+  // largest distance in meters between the fit and exact at check[]
+  double MaxError(const double* lat, const double* lon, const std::vector<size_t> &check,
+		  Exact exact) const;
+
+  // converts n points
+  void Convert(const double* lat, const double* lon, size_t n, double* north, double* east) const;
+
+protected:
+  void Terms(double lat, double lon, double t[USR_FIT_TERMS]) const;
+
+protected:
+  double m_lat0;
+  double m_lon0;
+  double m_inv_lat;  // 1 / largest |lat - lat0| fitted, keeps the terms near 1
+  double m_inv_lon;
+  double m_north[USR_FIT_TERMS];
+  double m_east[USR_FIT_TERMS];
+};
+
+#endif
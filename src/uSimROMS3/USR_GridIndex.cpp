@@ -0,0 +1,359 @@
+//---------------------------------------------------------------------
+// USR_GridIndex.cpp
+//
+// the ROMS grid is curvilinear, so there is no closed form going from a
+// local x/y position back to (eta, xi). instead every rho point is dropped
+// into a uniform bucket grid laid over the bounding box of the grid (about
+// one point per bucket). a query searches rings of buckets outward from the
+// bucket holding the query point and stops once nothing outside the rings
+// searched so far can be closer than the 4th closest point already found.
+
+#include <cmath>
+#include <algorithm>
+#include "USR_GridIndex.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// Constructor
+
+USR_GridIndex::USR_GridIndex()
+{
+  m_eta   = 0;
+  m_xi    = 0;
+  m_min_e = 0;
+  m_min_n = 0;
+  m_max_e = 0;
+  m_max_n = 0;
+  m_cell  = 1;
+  m_cols  = 0;
+  m_rows  = 0;
+  m_grid_e = 0;
+  m_grid_n = 0;
+}
+
+//---------------------------------------------------------------------
+// Procedure: Build
+// notes: sizes the buckets so there is roughly one grid point per bucket,
+//        then counting-sorts the points into them
+
+void USR_GridIndex::Build(const double* north, const double* east, int eta, int xi)
+{
+  m_eta = eta;
+  m_xi  = xi;
+  m_grid_e = east;
+  m_grid_n = north;
+  if(eta <= 0 || xi <= 0)
+    return;
+
+  m_min_e = m_max_e = east[0];
+  m_min_n = m_max_n = north[0];
+  for(int j = 0; j < eta; j++){
+    for(int i = 0; i < xi; i++){
+      m_min_e = min(m_min_e, east[j * xi + i]);
+      m_max_e = max(m_max_e, east[j * xi + i]);
+      m_min_n = min(m_min_n, north[j * xi + i]);
+      m_max_n = max(m_max_n, north[j * xi + i]);
+    }
+  }
+
+  double width  = m_max_e - m_min_e;
+  double height = m_max_n - m_min_n;
+  double points = (double)eta * (double)xi;
+  m_cell = sqrt(max(width * height, 1.0) / points);
+  if(m_cell <= 0 || width / m_cell > 1e5 || height / m_cell > 1e5)
+    m_cell = max(max(width, height) / 1e5, 1e-3);   // degenerate (single row or column) grids
+
+  m_cols = (int)(width / m_cell) + 1;
+  m_rows = (int)(height / m_cell) + 1;
+
+  int nbuckets = m_cols * m_rows;
+  int npoints  = eta * xi;
+  vector<int> bucket_of(npoints);
+  m_start.assign(nbuckets + 1, 0);
+
+  for(int j = 0; j < eta; j++){
+    for(int i = 0; i < xi; i++){
+      int c = min((int)((east[j * xi + i] - m_min_e) / m_cell), m_cols - 1);
+      int r = min((int)((north[j * xi + i] - m_min_n) / m_cell), m_rows - 1);
+      int b = r * m_cols + c;
+      bucket_of[j * xi + i] = b;
+      m_start[b + 1]++;
+    }
+  }
+  for(int b = 0; b < nbuckets; b++)
+    m_start[b + 1] += m_start[b];
+
+  m_items.resize(npoints);
+  m_item_e.resize(npoints);
+  m_item_n.resize(npoints);
+  vector<int> fill(m_start.begin(), m_start.end() - 1);
+  for(int j = 0; j < eta; j++){
+    for(int i = 0; i < xi; i++){
+      int slot = fill[bucket_of[j * xi + i]]++;
+      m_items[slot]  = j * xi + i;
+      m_item_e[slot] = east[j * xi + i];
+      m_item_n[slot] = north[j * xi + i];
+    }
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: Bytes
+
+size_t USR_GridIndex::Bytes() const
+{
+  return((m_start.size() + m_items.size()) * sizeof(int) +
+	 (m_item_e.size() + m_item_n.size()) * sizeof(double));
+}
+
+//---------------------------------------------------------------------
+// Procedure: Insert
+// notes: keeps best[] sorted by squared distance, closest first
+
+void USR_GridIndex::Insert(int idx, double d2, int best[4], double best_d2[4], int &found) const
+{
+  if(found == 4 && d2 >= best_d2[3])
+    return;
+  int k = (found < 4) ? found++ : 3;
+  while(k > 0 && best_d2[k - 1] > d2){
+    best[k]    = best[k - 1];
+    best_d2[k] = best_d2[k - 1];
+    k--;
+  }
+  best[k]    = idx;
+  best_d2[k] = d2;
+}
+
+//---------------------------------------------------------------------
+// Procedure: ScanBucket
+
+void USR_GridIndex::ScanBucket(int b, double x, double y, double max_d2,
+			       int best[4], double best_d2[4], int &found) const
+{
+  for(int s = m_start[b]; s < m_start[b + 1]; s++){
+    double de = m_item_e[s] - x;
+    double dn = m_item_n[s] - y;
+    double d2 = de * de + dn * dn;
+    if(d2 < max_d2)
+      Insert(m_items[s], d2, best, best_d2, found);
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: UnvisitedDist
+// notes: lower bound on the distance from (x, y) to any bucket outside the
+//        (2r+1)x(2r+1) block around (cx, cy). returns a huge value once the
+//        block covers the whole index
+
+static double distToRect(double x, double y, double x0, double y0, double x1, double y1)
+{
+  double dx = max(max(x0 - x, x - x1), 0.0);
+  double dy = max(max(y0 - y, y - y1), 0.0);
+  return(sqrt(dx * dx + dy * dy));
+}
+
+double USR_GridIndex::UnvisitedDist(double x, double y, int cx, int cy, int r) const
+{
+  double gx0 = m_min_e;
+  double gy0 = m_min_n;
+  double gx1 = m_min_e + m_cols * m_cell;
+  double gy1 = m_min_n + m_rows * m_cell;
+  double best = HUGE_VAL;
+
+  if(cx - r > 0)
+    best = min(best, distToRect(x, y, gx0, gy0, m_min_e + (cx - r) * m_cell, gy1));
+  if(cx + r < m_cols - 1)
+    best = min(best, distToRect(x, y, m_min_e + (cx + r + 1) * m_cell, gy0, gx1, gy1));
+  if(cy - r > 0)
+    best = min(best, distToRect(x, y, gx0, gy0, gx1, m_min_n + (cy - r) * m_cell));
+  if(cy + r < m_rows - 1)
+    best = min(best, distToRect(x, y, gx0, m_min_n + (cy + r + 1) * m_cell, gx1, gy1));
+  return(best);
+}
+
+//---------------------------------------------------------------------
+// Procedure: Nearest4
+// notes: x is easting, y is northing (same convention as m_posx/m_posy)
+
+int USR_GridIndex::Nearest4(double x, double y, double max_dist,
+			    int eta[4], int xi[4], double dist[4]) const
+{
+  int    best[4]    = {0, 0, 0, 0};
+  double best_d2[4] = {0, 0, 0, 0};
+  int    found      = 0;
+  double max_d2     = max_dist * max_dist;
+
+  if(!IsBuilt())
+    return(0);
+
+  int cx = (int)floor((x - m_min_e) / m_cell);
+  int cy = (int)floor((y - m_min_n) / m_cell);
+  cx = max(0, min(cx, m_cols - 1));
+  cy = max(0, min(cy, m_rows - 1));
+  int max_r = max(max(cx, m_cols - 1 - cx), max(cy, m_rows - 1 - cy));
+
+  for(int r = 0; r <= max_r; r++){
+    int r0 = max(cy - r, 0), r1 = min(cy + r, m_rows - 1);
+    int c0 = max(cx - r, 0), c1 = min(cx + r, m_cols - 1);
+    for(int row = r0; row <= r1; row++){
+      // only the outer ring of the block is new on this pass
+      if(row == cy - r || row == cy + r){
+	for(int col = c0; col <= c1; col++)
+	  ScanBucket(row * m_cols + col, x, y, max_d2, best, best_d2, found);
+      }
+      else{
+	if(cx - r >= 0)
+	  ScanBucket(row * m_cols + cx - r, x, y, max_d2, best, best_d2, found);
+	if(r > 0 && cx + r < m_cols)
+	  ScanBucket(row * m_cols + cx + r, x, y, max_d2, best, best_d2, found);
+      }
+    }
+    double bound = UnvisitedDist(x, y, cx, cy, r);
+    if(bound >= max_dist)
+      break;
+    if(found == 4 && bound * bound >= best_d2[3])
+      break;
+  }
+
+  for(int k = 0; k < found; k++){
+    eta[k]  = best[k] / m_xi;
+    xi[k]   = best[k] % m_xi;
+    dist[k] = sqrt(best_d2[k]);
+  }
+  return(found);
+}
+
+//---------------------------------------------------------------------
+// Procedure: WalkNearest4
+// notes: the vehicle only moves a few meters between calls, so the
+//        closest point is almost always the last one or one of its
+//        neighbors. greedy steps to whichever of the 8 neighboring cells is
+//        closest to (x, y), then takes the 4 closest points in the 5x5
+//        block of cells around the end of the walk.
+
+int USR_GridIndex::WalkNearest4(double x, double y, double max_dist, int start_eta, int start_xi,
+				int eta[4], int xi[4], double dist[4]) const
+{
+  const int max_steps = 16;  // further than this and the global search is cheaper
+  const int radius    = 2;   // half width of the block searched at the end of the walk
+
+  if(!IsBuilt() || start_eta < 0 || start_eta >= m_eta || start_xi < 0 || start_xi >= m_xi)
+    return(0);
+
+  int j = start_eta;
+  int i = start_xi;
+  double de = m_grid_e[j * m_xi + i] - x;
+  double dn = m_grid_n[j * m_xi + i] - y;
+  double cur_d2 = de * de + dn * dn;
+
+  int steps = 0;
+  for(; steps < max_steps; steps++){
+    int bj = j, bi = i;
+    for(int dj = -1; dj <= 1; dj++){
+      for(int di = -1; di <= 1; di++){
+	int nj = j + dj, ni = i + di;
+	if(nj < 0 || nj >= m_eta || ni < 0 || ni >= m_xi)
+	  continue;
+	de = m_grid_e[nj * m_xi + ni] - x;
+	dn = m_grid_n[nj * m_xi + ni] - y;
+	double d2 = de * de + dn * dn;
+	if(d2 < cur_d2){
+	  cur_d2 = d2;
+	  bj = nj;
+	  bi = ni;
+	}
+      }
+    }
+    if(bj == j && bi == i)
+      break;
+    j = bj;
+    i = bi;
+  }
+  if(steps == max_steps)
+    return(0);
+
+  int    best[4]    = {0, 0, 0, 0};
+  double best_d2[4] = {0, 0, 0, 0};
+  int    found      = 0;
+  double max_d2     = max_dist * max_dist;
+  int j0 = max(j - radius, 0), j1 = min(j + radius, m_eta - 1);
+  int i0 = max(i - radius, 0), i1 = min(i + radius, m_xi - 1);
+  for(int nj = j0; nj <= j1; nj++){
+    for(int ni = i0; ni <= i1; ni++){
+      int idx = nj * m_xi + ni;
+      de = m_grid_e[idx] - x;
+      dn = m_grid_n[idx] - y;
+      double d2 = de * de + dn * dn;
+      if(d2 < max_d2)
+	Insert(idx, d2, best, best_d2, found);
+    }
+  }
+  if(found < 4)
+    return(0);
+
+  // if any of the 4 sits on the border of the block, something just outside
+  // of it may be closer, so let the global search decide
+  for(int k = 0; k < 4; k++){
+    int bj = best[k] / m_xi, bi = best[k] % m_xi;
+    if((bj == j - radius && bj > 0) || (bj == j + radius && bj < m_eta - 1) ||
+       (bi == i - radius && bi > 0) || (bi == i + radius && bi < m_xi - 1))
+      return(0);
+  }
+
+  // a closest point much further away than the local cell size means
+  // we're off the edge of the grid (or across a fold in it)
+  int nj = (j + 1 < m_eta) ? j + 1 : j - 1;
+  int ni = (i + 1 < m_xi)  ? i + 1 : i - 1;
+  double span2 = 0;
+  if(nj >= 0 && ni >= 0){
+    de = m_grid_e[nj * m_xi + ni] - m_grid_e[j * m_xi + i];
+    dn = m_grid_n[nj * m_xi + ni] - m_grid_n[j * m_xi + i];
+    span2 = de * de + dn * dn;
+  }
+  if(best_d2[0] > span2)
+    return(0);
+
+  for(int k = 0; k < 4; k++){
+    eta[k]  = best[k] / m_xi;
+    xi[k]   = best[k] % m_xi;
+    dist[k] = sqrt(best_d2[k]);
+  }
+  return(4);
+}
+
+//---------------------------------------------------------------------
+// Procedure: USR_ScanNearest4
+// notes: the original search, walks every (eta, xi) pair in the grid
+
+int USR_ScanNearest4(const double* north, const double* east, int eta_rho, int xi_rho,
+		     double x, double y, double max_dist,
+		     int eta[4], int xi[4], double dist[4])
+{
+  double best_d2[4];
+  int    found = 0;
+  for(int k = 0; k < 4; k++)
+    best_d2[k] = max_dist * max_dist;
+
+  for(int j = 0; j < eta_rho; j++){
+    for(int i = 0; i < xi_rho; i++){
+      double d2 = pow(north[j * xi_rho + i] - y, 2) + pow(east[j * xi_rho + i] - x, 2);
+      if(d2 >= best_d2[3])
+	continue;
+      int k = 3;
+      while(k > 0 && best_d2[k - 1] > d2){
+	best_d2[k] = best_d2[k - 1];
+	eta[k]     = eta[k - 1];
+	xi[k]      = xi[k - 1];
+	k--;
+      }
+      best_d2[k] = d2;
+      eta[k]     = j;
+      xi[k]      = i;
+      if(found < 4)
+	found++;
+    }
+  }
+  for(int k = 0; k < found; k++)
+    dist[k] = sqrt(best_d2[k]);
+  return(found);
+}
@@ -0,0 +1,75 @@
+//---------------------------------------------------------------------
+// USR_GridIndex: uniform bucket grid over the local (north, east) meters
+// of every rho point in the ROMS grid. built once after ConvertToMeters()
+// so that finding the 4 closest grid points only has to look at the
+// buckets around the query point instead of walking the whole grid.
+
+#ifndef USR_GRIDINDEX_HEADER
+#define USR_GRIDINDEX_HEADER
+
+#include <vector>
+
+class USR_GridIndex
+{
+public:
+  USR_GridIndex();
+
+  // north/east are flat (eta, xi) arrays of local grid meters, indexed
+  // j*xi + i. they must outlive the index.
+  void Build(const double* north, const double* east, int eta, int xi);
+  bool IsBuilt() const {return(m_eta > 0 && m_xi > 0);}
+
+  // finds the 4 closest (eta, xi) pairs to (x, y) that lie within max_dist,
+  // sorted by distance. returns the number of pairs found (at most 4).
+  int  Nearest4(double x, double y, double max_dist,
+		int eta[4], int xi[4], double dist[4]) const;
+
+  // locality-aware version of Nearest4: walks the curvilinear grid from
+  // the cell (start_eta, start_xi) found on the last call towards (x, y)
+  // and only searches the cells around where the walk stops. returns 0
+  // when the answer can't be trusted locally (walked too far, or ended up
+  // on the edge of the neighborhood), in which case call Nearest4.
+  int  WalkNearest4(double x, double y, double max_dist, int start_eta, int start_xi,
+		    int eta[4], int xi[4], double dist[4]) const;
+
+  int  BucketCount() const {return(m_cols * m_rows);}
+  double CellSize() const  {return(m_cell);}
+  size_t Bytes() const;
+
+protected:
+  // distance from (x, y) to the part of the grid not yet covered after
+  // searching every bucket within ring r of bucket (cx, cy)
+  double UnvisitedDist(double x, double y, int cx, int cy, int r) const;
+  void   ScanBucket(int b, double x, double y, double max_d2,
+		    int best[4], double best_d2[4], int &found) const;
+  void   Insert(int idx, double d2, int best[4], double best_d2[4], int &found) const;
+
+protected:
+  int    m_eta;
+  int    m_xi;
+  double m_min_e;
+  double m_min_n;
+  double m_max_e;
+  double m_max_n;
+  double m_cell;
+  int    m_cols;   // buckets along east
+  int    m_rows;   // buckets along north
+
+  // bucket b holds points m_items[m_start[b]] .. m_items[m_start[b+1]-1],
+  // stored as j*xi + i along with a copy of their coordinates
+  std::vector<int>    m_start;
+  std::vector<int>    m_items;
+  std::vector<double> m_item_e;
+  std::vector<double> m_item_n;
+
+  // the arrays passed to Build(), in grid order, for walking the grid
+  const double* m_grid_e;
+  const double* m_grid_n;
+};
+
+// reference full-grid scan, kept for benchmarking and checking the index
+int USR_ScanNearest4(const double* north, const double* east, int eta_rho, int xi_rho,
+		     double x, double y, double max_dist,
+		     int eta[4], int xi[4], double dist[4]);
+
+#endif
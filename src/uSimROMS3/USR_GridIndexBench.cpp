@@ -0,0 +1,112 @@
+//---------------------------------------------------------------------
+// USR_GridIndexBench: compares the bucket grid index used by
+// LatLontoIndex against the original full-grid scan on a synthetic
+// curvilinear grid, so the index can be checked without a ROMS file.
+//
+// usage: uSimROMS3_GridIndexBench [eta_rho] [xi_rho] [queries]
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "USR_GridIndex.h"
+#include "USR_SyntheticGrid.h"
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  int eta_rho = (argc > 1) ? atoi(argv[1]) : 1000;
+  int xi_rho  = (argc > 2) ? atoi(argv[2]) : 800;
+  int queries = (argc > 3) ? atoi(argv[3]) : 200;
+  double chk_dist = 100000;
+
+  vector<double> meters_n(size_t(eta_rho) * xi_rho);
+  vector<double> meters_e(size_t(eta_rho) * xi_rho);
+  USR_SyntheticGrid(eta_rho, xi_rho, &meters_n[0], &meters_e[0]);
+
+  auto t0 = chrono::steady_clock::now();
+  USR_GridIndex index;
+  index.Build(&meters_n[0], &meters_e[0], eta_rho, xi_rho);
+  auto t1 = chrono::steady_clock::now();
+  double build_ms = chrono::duration<double, milli>(t1 - t0).count();
+
+  // query at random points of the grid, jittered off the grid points
+  mt19937 rng(12345);
+  uniform_int_distribution<int> pick_j(0, eta_rho - 1);
+  uniform_int_distribution<int> pick_i(0, xi_rho - 1);
+  uniform_real_distribution<double> jitter(-150.0, 150.0);
+  double* qx = new double[queries];
+  double* qy = new double[queries];
+  for(int q = 0; q < queries; q++){
+    int j = pick_j(rng), i = pick_i(rng);
+    qx[q] = meters_e[j * xi_rho + i] + jitter(rng);
+    qy[q] = meters_n[j * xi_rho + i] + jitter(rng);
+  }
+
+  int eta_a[4], xi_a[4], eta_b[4], xi_b[4];
+  double dist_a[4], dist_b[4];
+  int mismatches = 0;
+
+  t0 = chrono::steady_clock::now();
+  for(int q = 0; q < queries; q++)
+    USR_ScanNearest4(&meters_n[0], &meters_e[0], eta_rho, xi_rho, qx[q], qy[q], chk_dist, eta_a, xi_a, dist_a);
+  t1 = chrono::steady_clock::now();
+  double scan_us = chrono::duration<double, micro>(t1 - t0).count() / queries;
+
+  t0 = chrono::steady_clock::now();
+  for(int q = 0; q < queries; q++)
+    index.Nearest4(qx[q], qy[q], chk_dist, eta_b, xi_b, dist_b);
+  t1 = chrono::steady_clock::now();
+  double index_us = chrono::duration<double, micro>(t1 - t0).count() / queries;
+
+  for(int q = 0; q < queries; q++){
+    int na = USR_ScanNearest4(&meters_n[0], &meters_e[0], eta_rho, xi_rho, qx[q], qy[q], chk_dist, eta_a, xi_a, dist_a);
+    int nb = index.Nearest4(qx[q], qy[q], chk_dist, eta_b, xi_b, dist_b);
+    bool same = (na == nb);
+    for(int k = 0; same && k < na; k++)
+      same = fabs(dist_a[k] - dist_b[k]) < 1e-6;
+    if(!same)
+      mismatches++;
+  }
+
+  // follow a slowly turning track through the middle of the grid, 5 m
+  // per call, using the last answer as the starting point of the walk
+  int steps = 100 * queries;
+  double tx = meters_e[(eta_rho / 2) * xi_rho + xi_rho / 2];
+  double ty = meters_n[(eta_rho / 2) * xi_rho + xi_rho / 2];
+  double head = 0;
+  int prev_eta = -1, prev_xi = -1, fallbacks = 0;
+  t0 = chrono::steady_clock::now();
+  for(int s = 0; s < steps; s++){
+    head += (s % 400 == 0) ? 1.0 : 0.001;
+    tx += 5.0 * cos(head);
+    ty += 5.0 * sin(head);
+    int n = 0;
+    if(prev_eta >= 0)
+      n = index.WalkNearest4(tx, ty, chk_dist, prev_eta, prev_xi, eta_b, xi_b, dist_b);
+    if(n == 0){
+      fallbacks++;
+      n = index.Nearest4(tx, ty, chk_dist, eta_b, xi_b, dist_b);
+    }
+    prev_eta = (n == 4) ? eta_b[0] : -1;
+    prev_xi  = (n == 4) ? xi_b[0] : -1;
+  }
+  t1 = chrono::steady_clock::now();
+  double walk_us = chrono::duration<double, micro>(t1 - t0).count() / steps;
+
+  cout << "grid:        " << eta_rho << " x " << xi_rho << " (" << index.BucketCount()
+       << " buckets, " << index.CellSize() << " m)" << endl;
+  cout << "index build: " << build_ms << " ms" << endl;
+  cout << "full scan:   " << scan_us << " us/query" << endl;
+  cout << "grid index:  " << index_us << " us/query" << endl;
+  cout << "speedup:     " << scan_us / index_us << "x" << endl;
+  cout << "track walk:  " << walk_us << " us/query (" << fallbacks << " of " << steps
+       << " fell back to the grid index)" << endl;
+  cout << "mismatches:  " << mismatches << " of " << queries << endl;
+
+  delete [] qx;
+  delete [] qy;
+  return(mismatches == 0 ? 0 : 1);
+}
@@ -49,6 +49,17 @@ void showHelpAndExit()
   blk("      Display MOOS publications and subscriptions.              ");
   mag("  --version,-v                                                  ");
   blk("      Display the release version of uSimROMS.               ");
+  mag("  --serve                                                       ");
+  blk("      Load the fields into SHARED_FIELD for other instances to  ");
+  blk("      attach to and wait until interrupted.                     ");
+  mag("  --batch","=<points.csv>                                       ");
+  blk("      Sample the fields at every \"time, x, y, depth\" line of  ");
+  blk("      the file and exit, no MOOSDB needed.                      ");
+  mag("  --out","=<values.csv>                                         ");
+  blk("      Where --batch writes its values, columnar binary if the   ");
+  blk("      name ends in .bin.                                        ");
+  mag("  --threads","=<N>                                              ");
+  blk("      Threads --batch samples on, defaults to all cores.        ");
   blk("                                                                ");
   blk("Note: If argv[2] does not otherwise match a known option,       ");
   blk("      then it will be interpreted as a run alias. This is       ");
@@ -73,14 +84,25 @@ void showExampleConfigAndExit()
   blk("  CommsTick = 4                                                 ");
   blk("                                                                ");
   blk("  NC_FILE_NAME = file.nc                                        ");
-  blk("  OUTPUT_VARIABLE = SALINITY                                    ");
+  blk("  OUTPUT_VARIABLE = SALINITY,TEMPERATURE                        ");
   blk("  SAFE_DEPTH_OUTPUT = SAFE_DEPTH                                ");
-  blk("  SCALAR_VARIABLE = salt                                        ");
+  blk("  SCALAR_VARIABLE = salt,temp                                   ");
   blk("  BAD_VALUE = -1                                                ");
   blk("  LOOK_FORWARD = 20                                             ");
-  blk("                                                                ");
-  blk("                                                                ");
-  blk("                                                                "); 
+  blk("  LOCAL_SEARCH = true                                           ");
+  blk("  STREAM_FIELD = false                                          ");
+  blk("  RESIDENT_SLICES = 3                                           ");
+  blk("  TILE_FIELD = false                                            ");
+  blk("  TILE_SIZE = 64                                                ");
+  blk("  RESIDENT_TILES = 32                                           ");
+  blk("  TILE_LOOKAHEAD = 1000                                         ");
+  blk("  SINGLE_PRECISION = false                                      ");
+  blk("  FAST_CONVERT = true                                           ");
+  blk("  CONVERT_TOLERANCE = 0.1                                       ");
+  blk("  FIELD_CACHE = file.usrcache                                   ");
+  blk("  SHARED_FIELD = /roms_salt                                     ");
+  blk("  FIELD_SERVER = false                                          ");
+  blk("  SHARED_FIELD_WAIT = 60                                        ");
   blk("                                                                ");
   blk("}                                                               ");
   blk("                                                                ");
@@ -110,7 +132,8 @@ void showInterfaceAndExit()
   blk("                                                                ");
   blk("PUBLICATIONS:                                                   ");
   blk("------------------------------------                            ");
-  blk("  SCALAR_VALUE = 17.778                                         ");
+  blk("  SCALAR_VALUE = 17.778 (or the OUTPUT_VARIABLE names)         ");
+  blk("  SAFE_DEPTH   = 32.5                                           ");
   blk("                                                                ");
   blk("                                                                ");
   blk("                                                                ");
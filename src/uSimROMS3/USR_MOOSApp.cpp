@@ -19,6 +19,13 @@
 #include "AngleUtils.h"
 #include <string>
 #include <ctime>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <csignal>
+#include <sys/mman.h>
+#include "USR_Parallel.h"
+#include "USR_GridFit.h"
 using namespace std;
 
 //------------------------------------------------------------------------
@@ -32,7 +39,6 @@ USR_MOOSApp::USR_MOOSApp()
   m_depth    = 0;
   m_head     = 0;
   m_rTime = "2010-10-30 12:34:56";
-  time_step = 0;
 
   //defualt values for things
   maskRhoVarName = "mask_rho";        
@@ -41,7 +47,6 @@ USR_MOOSApp::USR_MOOSApp()
   sVarName = "s_rho";
   timeVarName = "ocean_time";
   bathyVarName = "h";
-  scalarOutputVar = "SCALAR_VALUE";
   safeDepthVar = "SAFE_DEPTH";
   look_fwd = 50;
 
@@ -54,7 +59,42 @@ USR_MOOSApp::USR_MOOSApp()
 
   bad_val = -1;
 
- 
+  local_search = true;
+  fwd_valid = false;
+
+  stream_field = false;
+  resident_slices = 3;
+  stream_file = NULL;
+  tile_field = false;
+  tile_size = 64;
+  resident_tiles = 32;
+  tile_lookahead = 1000;
+  tiles_eta = 0;
+  tiles_xi = 0;
+  ahead_valid = false;
+
+  lat_origin = 0;
+  long_origin = 0;
+  s_sorted = false;
+  single_precision = false;
+  fast_convert = true;
+  convert_tol = 0.1;
+  field_server = false;
+  shared_wait = 60;
+  shared_owner = false;
+}
+
+//------------------------------------------------------------------------
+// Destructor
+//      Note: the prefetch thread has to be stopped before its file is closed
+
+USR_MOOSApp::~USR_MOOSApp()
+{
+  slice_cache.Stop();
+  tile_cache.Stop();
+  delete stream_file;
+  if(shared_owner)
+    USR_UnlinkSharedField();
 }
 
 //------------------------------------------------------------------------
@@ -83,14 +123,64 @@ bool USR_MOOSApp::OnNewMail(MOOSMSG_LIST &NewMail)
 
 //------------------------------------------------------------------------
 // Procedure: OnStartUp
-//      Note: initializes paramters based on what it finds in the moos file
+//      Note: 
 
 bool USR_MOOSApp::OnStartUp()
 {
   cout << "uSimROMS3: SimROMS3 Starting" << endl;
-  
+  if(!Configure(GetAppName())){
+    std::exit(0);        //if we can't read the file, exit the program so it's clear something went wrong and
+  }                     //so we don't publish misleading or dangerous values, using exit() probably isn't the
+                        //best way, but it works
+
+  registerVariables();    
+
+  cout << "uSimROMS3: SimROMS3 started" << endl;
+  return(true);
+}
+
+//------------------------------------------------------------------------
+// Procedure: RunServer
+//      Note: a field server without a vehicle, for uSimROMS3 file.moos --serve. loads the fields, publishes
+//            them as SHARED_FIELD and keeps them there until it is interrupted
+
+static volatile sig_atomic_t server_stop = 0;
+static void StopServer(int) {server_stop = 1;}
+
+bool USR_MOOSApp::RunServer(string mission_file, string app_name)
+{
+  m_MissionReader.SetFile(mission_file);
+  m_MissionReader.SetAppName(app_name);
+  field_server = true;
+  if(!Configure(app_name))
+    return false;
+  if(shared_field == ""){
+    cout << "uSimROMS3: --serve needs SHARED_FIELD to be set" << endl;
+    return false;
+  }
+  if(!shared_owner){
+    cout << "uSimROMS3: " << shared_field << " is already being served" << endl;
+    return false;
+  }
+
+  signal(SIGINT, StopServer);
+  signal(SIGTERM, StopServer);
+  cout << "uSimROMS3: serving " << shared_field << " until interrupted" << endl;
+  while(!server_stop)
+    this_thread::sleep_for(chrono::milliseconds(200));
+  cout << "uSimROMS3: removing shared field " << shared_field << endl;
+  return true;
+}
+
+//------------------------------------------------------------------------
+// Procedure: Configure
+//      Note: initializes paramters based on what it finds in the moos file and loads the ROMS fields. 
+//            returns false if the fields can't be loaded
+
+bool USR_MOOSApp::Configure(string app_name)
+{
   STRING_LIST sParams;
-  m_MissionReader.GetConfiguration(GetAppName(), sParams);
+  m_MissionReader.GetConfiguration(app_name, sParams);
     
   STRING_LIST::iterator p;
   for(p = sParams.begin();p!=sParams.end();p++) {
@@ -104,16 +194,19 @@ bool USR_MOOSApp::OnStartUp()
     if(param == "NC_FILE_NAME"){  //required
        ncFileName = value;
      }
-    if(param == "OUTPUT_VARIABLE"){  //defaults to SCALAR_VALUE
-       scalarOutputVar = value;
-       cout << "uSimROMS3: publishing under name: " << scalarOutputVar;
+    if(param == "OUTPUT_VARIABLE"){  //comma separated, one per SCALAR_VARIABLE, defaults to SCALAR_VALUE
+       scalarOutputVars = parseString(value, ',');
+       for(unsigned int v = 0; v < scalarOutputVars.size(); v++)
+	 scalarOutputVars[v] = stripBlankEnds(scalarOutputVars[v]);
      }
     if(param == "SAFE_DEPTH_OUTPUT"){
       safeDepthVar = value;
       cout << "uSimROMS3: publishing safe depth under name: " << safeDepthVar << endl;
     }
-    if(param == "SCALAR_VARIABLE"){  //e.g. salt or temprature
-       varName = value;
+    if(param == "SCALAR_VARIABLE"){  //e.g. salt or temprature, or a comma separated list like salt,temp,u,v
+       varNames = parseString(value, ',');
+       for(unsigned int v = 0; v < varNames.size(); v++)
+	 varNames[v] = stripBlankEnds(varNames[v]);
      }
     if(param == "MASK_VARIABLE"){   //name of variable holding land mask = 0
        maskRhoVarName = value;
@@ -166,33 +259,176 @@ bool USR_MOOSApp::OnStartUp()
 	 bathy_only = true;
        }else bathy_only = false;
      }
+     //walk the grid from the last known cell instead of searching the whole grid every tick
+     if(param == "LOCAL_SEARCH"){
+       local_search = (toupper(value) == "TRUE");
+     }
+     //read time slices of the field as they are needed instead of loading the whole variable
+     if(param == "STREAM_FIELD"){
+       stream_field = (toupper(value) == "TRUE");
+     }
+     if(param == "RESIDENT_SLICES"){
+       resident_slices = atoi(value.c_str());
+       if(resident_slices < 2)
+	 resident_slices = 2;
+       cout << "uSimROMS3: keeping at most " << resident_slices << " time slices in memory when streaming" << endl;
+     }
+     //read the field a horizontal tile at a time, for grids too big to hold even one time step of
+     if(param == "TILE_FIELD"){
+       tile_field = (toupper(value) == "TRUE");
+     }
+     if(param == "TILE_SIZE"){
+       tile_size = atoi(value.c_str());
+       if(tile_size < 8)
+	 tile_size = 8;
+     }
+     if(param == "RESIDENT_TILES"){   //GetValue() holds up to 4 tiles at once
+       resident_tiles = atoi(value.c_str());
+       if(resident_tiles < 4)
+	 resident_tiles = 4;
+       cout << "uSimROMS3: keeping at most " << resident_tiles << " tiles in memory when tiling" << endl;
+     }
+     //meters ahead of the vehicle that tiles are read in, keep it under the width of a tile
+     if(param == "TILE_LOOKAHEAD"){
+       tile_lookahead = atof(value.c_str());
+     }
+     //convert the grid to meters with a fitted local tangent plane instead of calling geodesy for every point
+     if(param == "FAST_CONVERT"){
+       fast_convert = (toupper(value) == "TRUE");
+     }
+     //largest error in meters allowed for FAST_CONVERT
+     if(param == "CONVERT_TOLERANCE"){
+       convert_tol = atof(value.c_str());
+     }
+     //keep the fields as float, the way ROMS writes them, instead of double
+     if(param == "SINGLE_PRECISION"){
+       single_precision = (toupper(value) == "TRUE");
+     }
+     //mmap a preprocessed copy of the field and grids, written on the first launch
+     if(param == "FIELD_CACHE"){
+       field_cache_file = value;
+     }
+     //share one copy of the field between all the simulators on this host, see USR_FieldCache.h
+     if(param == "SHARED_FIELD"){
+       shared_field = (value != "" && value[0] != '/') ? "/" + value : value;
+     }
+     if(param == "FIELD_SERVER"){
+       field_server = (toupper(value) == "TRUE");
+     }
+     if(param == "SHARED_FIELD_WAIT"){
+       shared_wait = atof(value.c_str());
+     }
      if(param == "LOOK_FORWARD"){
        look_fwd = atof(value.c_str());
        cout << "uSimROMS3: using " << look_fwd << " as the LOOK_FORWARD distance" << endl; 
      }
      
   }
+  //the first variable keeps the old SCALAR_VALUE default, any others default to their own name
+  for(int v = scalarOutputVars.size(); v < NumVars(); v++)
+    scalarOutputVars.push_back(v == 0 ? "SCALAR_VALUE" : toupper(varNames[v]));
+  scalarOutputVars.resize(NumVars());
+  for(int v = 0; v < NumVars(); v++)
+    cout << "uSimROMS3: publishing \"" << varNames[v] << "\" under name: " << scalarOutputVars[v] << endl;
+  var_values.assign(NumVars(), bad_val);
+
   // look for latitude, longitude global variables
-  double latOrigin, longOrigin;
-  if(!m_MissionReader.GetValue("LatOrigin", latOrigin))
+  if(!m_MissionReader.GetValue("LatOrigin", lat_origin))
     cout << "uSimROMS3: LatOrigin not set in *.moos file." << endl;
-  else if(!m_MissionReader.GetValue("LongOrigin", longOrigin))
+  else if(!m_MissionReader.GetValue("LongOrigin", long_origin))
     cout << "uSimROMS3: LongOrigin not set in *.moos file" << endl;
   else
-  geodesy.Initialise(latOrigin, longOrigin);  //initializes the geodesy class  
+  geodesy.Initialise(lat_origin, long_origin);  //initializes the geodesy class  
 
-  if(!ReadNcFile()){    //loads all the data into local memory that we can actually use
-    std::exit(0);        //if we can't read the file, exit the program so it's clear something went wrong and
-  }                     //so we don't publish misleading or dangerous values, using exit() probably isn't the
-                        //best way, but it works
-  ConvertToMeters();
+  if(varNames.empty()){
+    cout << "uSimROMS3: no SCALAR_VARIABLE given, exiting" << endl;
+    return false;
+  }
 
-  registerVariables();    
+  if(tile_field && stream_field){
+    cout << "uSimROMS3: tiles are read one time step at a time, STREAM_FIELD is ignored" << endl;
+    stream_field = false;
+  }
+  if(single_precision && (stream_field || tile_field)){
+    cout << "uSimROMS3: streamed time slices and tiles are kept as double, SINGLE_PRECISION is ignored" << endl;
+    single_precision = false;
+  }
 
-  cout << "uSimROMS3: SimROMS3 started" << endl;
+  //a shared field or field cache that still matches the nc file replaces both reading the file and
+  //converting to meters
+  bool shared = (shared_field != "") && AttachSharedField();
+  bool cached = shared || ((field_cache_file != "") && LoadFieldCache(field_cache_file, false));
+  if(cached && (stream_field || tile_field)){
+    cout << "uSimROMS3: field cache is mapped, pages are read on demand so STREAM_FIELD and TILE_FIELD are ignored" << endl;
+    stream_field = false;
+    tile_field = false;
+  }
+  if(!cached && tile_field && (field_cache_file != "" || field_server)){
+    cout << "uSimROMS3: a tiled field is never all in memory, not writing FIELD_CACHE or serving SHARED_FIELD" << endl;
+    field_cache_file = "";
+    field_server = false;
+  }
+  if(!cached){
+    if(!ReadNcFile())    //loads all the data into local memory that we can actually use
+      return false;
+    ConvertToMeters();
+    if(field_cache_file != "")
+      SaveFieldCache();
+    if(tile_field){
+      lat.release();    //only needed for the conversion, a tiled field is never cached or shared
+      lon.release();
+    }
+  }
+  if(shared_field != "" && field_server && !shared){
+    if(ServeSharedField() && stream_field){
+      slice_cache.Stop();    //the shared copy has every time step
+      stream_field = false;
+    }
+  }
+  BuildDepthTable();
+  grid_index.Build(&meters_n[0], &meters_e[0], eta_rho, xi_rho);
+  cout << "uSimROMS3: grid index built with " << grid_index.BucketCount() << " buckets of "
+       << grid_index.CellSize() << " m" << endl;
+  ReportMemory();
   return(true);
 }
 
+//------------------------------------------------------------------------
+// Procedure: ReportMemory
+//      Note: prints what the loaded fields, grids and index take up, for sizing the vehicle computer. arrays
+//            in a mapped field cache are shared with every other simulator mapping the same file. a tiled
+//            field is capped at RESIDENT_TILES, the resident grids and index are not
+
+void USR_MOOSApp::ReportMemory()
+{
+  double field_mb;
+  string field_how;
+  if(stream_field){
+    field_mb  = slice_cache.Capacity() * slice_cache.SliceBytes() / 1e6;
+    field_how = "at most, streamed as double";
+  }else if(tile_field){
+    field_mb  = tile_cache.Capacity() * tile_cache.SliceBytes() / 1e6;
+    field_how = "at most, tiled as double";
+  }else if(single_precision){
+    field_mb  = vals_f.size() * sizeof(float) / 1e6;
+    field_how = "float";
+  }else{
+    field_mb  = vals.size() * sizeof(double) / 1e6;
+    field_how = "double";
+  }
+  double grid_mb  = (lat.size() + lon.size() + meters_n.size() + meters_e.size() + bathy.size()) * sizeof(double) / 1e6
+                  + maskRho.size() * sizeof(int) / 1e6;
+  double index_mb = grid_index.Bytes() / 1e6;
+  
+  cout << "uSimROMS3: memory footprint: fields " << field_mb << " MB (" << field_how << "), grids " << grid_mb
+       << " MB, grid index " << index_mb << " MB, total " << field_mb + grid_mb + index_mb << " MB";
+  if(tile_field)    //the grids and index grow with the grid even though the field doesn't
+    cout << " (grids and index " << (grid_mb + index_mb) * 1e6 / Cell(eta_rho, 0) << " bytes per grid cell)";
+  if(field_cache.Data() != NULL)
+    cout << " (fields and grids mapped from " << field_cache_name << ")";
+  cout << endl;
+}
+
 
 //------------------------------------------------------------------------
 // Procedure: OnConnectToServer
@@ -234,7 +470,6 @@ bool USR_MOOSApp::OnDisconnectFromServer()
 
 bool USR_MOOSApp::Iterate()
 {
-  double  value; 
   //cout << "USR: Getting time..." << endl;
   GetTimeInfo(); 
   //cout << "USR: REMUS_TIME: " << m_rTime.c_str() << " at index=" << time_step << endl;
@@ -243,27 +478,45 @@ bool USR_MOOSApp::Iterate()
   //cout << "USR: converted lat/long to northing/easting" << endl;
 
 
-  if(!LatLontoIndex(closest_eta , closest_xi, closest_distance, m_posx, m_posy)){  //returns eta and xi, returns false if we're outside the ROMS grid, in which case 
+  here.x     = m_posx;
+  here.y     = m_posy;
+  here.depth = m_depth;
+  here.valid = LatLontoIndex(here.eta , here.xi, here.dist, here.x, here.y, here.valid);
+  if(!here.valid){  //returns eta and xi, returns false if we're outside the ROMS grid, in which case 
     cout << "uSimROMS3: no value found at current location" << endl;               //let the user know and don't publish
     return false;
   }          
-  GetBathy(closest_eta, closest_xi,closest_distance, floor_depth);
-  m_altitude = floor_depth - m_depth;     
-  GetS_rho();
+  if(!GetBathy(here.eta, here.xi, here.dist, here.floor_depth)){
+    cout << "uSimROMS3: all local grid points are land, refusing to publish new values" << endl;
+    return false;
+  }
+  m_altitude = here.floor_depth - m_depth;     
+  GetS_rho(here);
 
   if(!GetSafeDepth()){
     cout << "no value found at check location, refusing to publish new values" << endl; 
     return false;
   }
-  value = GetValue();
-  if(value == bad_val){  //if the value is good, go ahead and publish it
-    cout << "uSimROMS3: all local values are bad, refusing to publish new values" << endl;
+  if(tile_field)
+    PrefetchTiles();
+  if(!GetValue(here, &var_values[0])){
+    cout << "uSimROMS3: unable to read the field, refusing to publish new values" << endl;
     return false;
   }
+  if(!here.more_time && !time_message_posted){
+    cout << "uSimROMS3: warning: current time is past the last time step, now using data only data from last time step" << endl;
+    time_message_posted = true; // we only want to give this warning once
+  }
   
   //if nothing has failed we can safely publish
   Notify(safeDepthVar.c_str(), safe_depth);
-  Notify(scalarOutputVar.c_str(), value);
+  for(int v = 0; v < NumVars(); v++){
+    if(var_values[v] == bad_val){  //if the value is good, go ahead and publish it
+      cout << "uSimROMS3: all local values of " << varNames[v] << " are bad, refusing to publish it" << endl;
+      continue;
+    }
+    Notify(scalarOutputVars[v].c_str(), var_values[v]);
+  }
   //cout << "uSR: uSimROMS is publishing value :" << value << endl;
   
   return(true);
@@ -272,74 +525,32 @@ bool USR_MOOSApp::Iterate()
 //---------------------------------------------------------------------
 // Procedure: LatLongtoIndex
 // notes: stores the 4 closest index pairs well as their distance from the given x , y coordinate. if no lat lon pairs are within 
-//        1 (may be lowered) then we assume we are outside the grid, and return false. this is very primitive
-//        (read: slow) right  now, but may be sped up later using a more sophisticated data structure if this
-//        way is not tennable.
+//        chk_dist then we assume we are outside the grid, and return false. the search goes through grid_index (a bucket
+//        grid built once in OnStartUp) so only the grid points near x, y are looked at instead of the whole ROMS grid.
+//        if use_prev is set, eta[0]/xi[0] hold the closest point from the last call and the search first walks
+//        the grid from there, only falling back to grid_index when the walk can't give a trustworthy answer.
 
-bool USR_MOOSApp::LatLontoIndex(int eta[4], int xi[4], double dist[4], double x , double y)
+bool USR_MOOSApp::LatLontoIndex(int eta[4], int xi[4], double dist[4], double x , double y, bool use_prev)
 {
 
   int chk_dist = 100000; //distance to check for grid points, if nothing pops up we assume we're outside the grid(hardcoded for now)
-  //intialize the arrays we'll be storing things in
-  for(int i = 0; i < 4; i++){
-    eta[i] = 0;
-    xi[i] = 0;
-    dist[i] = chk_dist;
-  }  
-
-  //these nested fors go through the entire ROMS grid searching for the 4 closest index pairs to the current lat
-  //lon coordinate.
-  for(int j = 0; j < eta_rho; j++)
-    {
-      for(int i = 0; i < xi_rho; i++){
-       if(pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2) < pow(dist[0],2)){
-	dist[3] = dist[2];
-	   eta[3] = eta[2];
-	   xi[3] = xi[2];
-	dist[2] = dist[1];
-	   eta[2] = eta[1];
-	   xi[2] = xi[1];
-	dist[1] = dist[0];
-	   eta[1] = eta[0];
-	   xi[1] = xi[0];
-	   dist[0] = sqrt((pow(meters_n[j][i] - y, 2) + pow(meters_e[j][i] - x, 2)));
-	   eta[0] = j;
-	   xi[0] = i;
-      }
-     else if(pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2) < pow(dist[1],2)){
-	dist[3] = dist[2];
-	   eta[3] = eta[2];
-	   xi[3] = xi[2];
-	dist[2] = dist[1];
-	   eta[2] = eta[1];
-	   xi[2] = xi[1];
-	   dist[1] = sqrt((pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2)));
-	   eta[1] = j;
-	   xi[1] = i;
-      }
-     else if(pow(meters_n[j][i] - x,2) + pow(meters_e[j][i] - y, 2) < pow(dist[2],2)){
-	dist[3] = dist[2];
-	   eta[3] = eta[2];
-	   xi[3] = xi[2];
-	   dist[2] = sqrt((pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2)));
-	   eta[2] = j;
-	   xi[2] = i;
-      }
-     else if(pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2) < pow(dist[3],2)){
-       dist[3] = sqrt((pow(meters_n[j][i] - y,2) + pow(meters_e[j][i] - x, 2)));
-	  eta[3] = j;
-	  xi[3] = i;
-      }
-	 
-    }     
-} 
-
-  // printf("distances in latlon to index\n: , %f %f %f %f" , dist[0], dist[1], dist[2], dist[3]);
-  //when the loop exits the index with the closest lat/lon pair to the current position will be in i and j 
-  //if none of the values were close return false
-  if(dist[0] ==  chk_dist || dist[1] == chk_dist || dist[2] == chk_dist || dist[1] == chk_dist)
+  int found = 0;
+  if(local_search && use_prev)
+    found = grid_index.WalkNearest4(x, y, chk_dist, eta[0], xi[0], eta, xi, dist);
+
+  if(found < 4){
+    //intialize the arrays we'll be storing things in
+    for(int i = 0; i < 4; i++){
+      eta[i] = 0;
+      xi[i] = 0;
+      dist[i] = chk_dist;
+    }  
+    found = grid_index.Nearest4(x, y, chk_dist, eta, xi, dist);
+  }
+
+  //if fewer than 4 grid points were close return false, the caller reports it
+  if(found < 4)
     {
-     cout <<"uSimROMS3: error : current lat lon pair not found in nc file " << endl;
      for(int i = 0; i < 4; i ++)
        {
        eta[i]  = 0; //these zeroes aren't used for anything, but having junk values is bad
@@ -351,18 +562,31 @@ bool USR_MOOSApp::LatLontoIndex(int eta[4], int xi[4], double dist[4], double x
 }
 
 
+//----------------------------------------------------------------------
+//Procedure: BuildDepthTable
+//notes: the depth of s level k in a column of depth h is -s_values[k] * h, so one table of -s_values serves every
+//       column and the vertical search in GetS_rho() becomes a binary search over it
+void USR_MOOSApp::BuildDepthTable()
+{
+  s_frac.resize(s_rho);
+  s_sorted = true;
+  for(int k = 0; k < s_rho; k++){
+    s_frac[k] = -s_values[k];
+    if(k > 0 && s_frac[k] >= s_frac[k - 1])
+      s_sorted = false;
+  }
+  if(!s_sorted)
+    cout << "uSimROMS3: warning: s values aren't ordered bottom to surface, using a linear depth search" << endl;
+}
+
 //----------------------------------------------------------------------
 //Procedure: GetS_rho
 //notes: takes altitude and depth along with data on s_values pulled fro the NC file to get the current s_rho coordinate
 // NJN: 2014/12/03: re-wrote routine to find nearest sigma levels
- bool USR_MOOSApp::GetS_rho(){
-   double * s_depths = new double[s_rho];
-   for(int i = 0; i < s_rho; i++){
-     // sigma[0] = -1 = ocean bottom
-     // sigma[s_rho] = 0 = free surface
-     s_depths[i] = -s_values[i] * floor_depth;  
-     //cout << s_depths[i] << endl;
-   }
+ bool USR_MOOSApp::GetS_rho(USR_Query &q){
+   // sigma[0] = -1 = ocean bottom
+   // sigma[s_rho] = 0 = free surface
+   // the depth of level k here is s_frac[k] * q.floor_depth
 
    // Find last sigma level deeper than current depth
    // e.g. vehicle depth of 1.5 m on a grid with
@@ -370,22 +594,33 @@ bool USR_MOOSApp::LatLontoIndex(int eta[4], int xi[4], double dist[4], double x
    // s_level = 1 (that is: sigma[1] = 1.7 is the
    //                  last depth below.)
    int k = 0;
-   while ((k < s_rho) && (s_depths[k] > m_depth)){
-     k++;
+   if(s_sorted){
+     int hi = s_rho;   // first level that isn't deeper than the vehicle is in [k, hi]
+     while(k < hi){
+       int mid = (k + hi) / 2;
+       if(s_frac[mid] * q.floor_depth > q.depth)
+	 k = mid + 1;
+       else
+	 hi = mid;
+     }
+   }else{
+     while ((k < s_rho) && (s_frac[k] * q.floor_depth > q.depth)){
+       k++;
+     }
    }
-   s_level = k - 1;
+   q.s_level = k - 1;
    
    // Check for the special cases of being above the surface bin
    // or below the bottom bin.
-   if (s_level > 0){
-     distSigma = s_depths[s_level] - m_depth;
+   if (q.s_level > 0){
+     q.distSigma = s_frac[q.s_level] * q.floor_depth - q.depth;
    } else {
-     distSigma = -1;
+     q.distSigma = -1;
    }
-   if (s_level == s_rho - 1){
-     distSp1 = -1;
+   if (q.s_level == s_rho - 1){
+     q.distSp1 = -1;
    }else{
-     distSp1 = m_depth - s_depths[s_level + 1];
+     q.distSp1 = q.depth - s_frac[q.s_level + 1] * q.floor_depth;
    }
 
    //   cout << "uSR: Vehicle depth " << m_depth << endl;
@@ -396,6 +631,23 @@ bool USR_MOOSApp::LatLontoIndex(int eta[4], int xi[4], double dist[4], double x
  }
 
 
+//---------------------------------------------------------------------
+//Sample
+//notes: the whole lookup for one point (q.x, q.y, q.depth, q.time), the way Iterate() does it for the vehicle. only
+//       reads shared data, so it can run on several threads at once with a query each. returns false if the point
+//       is off the grid, on land or a time step can't be read
+bool USR_MOOSApp::Sample(USR_Query &q, double* values)
+{
+  q.valid = LatLontoIndex(q.eta, q.xi, q.dist, q.x, q.y, q.valid);
+  if(!q.valid)
+    return false;
+  if(!GetBathy(q.eta, q.xi, q.dist, q.floor_depth))
+    return false;
+  GetS_rho(q);
+  FindTimeStep(q);
+  return GetValue(q, values);
+}
+
 //---------------------------------------------------------------------
 //GetTimeInfo
 // notes: should check if there are any more time values, determine the current time step, and the time difference 
@@ -447,137 +699,271 @@ bool USR_MOOSApp::GetTimeInfo(){
   current_time = difftime(mktime(remusTime), mktime(&epoch));
   //cout << "USR::GetTimeInfo: current time = " << current_time << endl;
 
-  for(int i = 0; i < time_vals; i++){
-  //  cout << time[n] << endl;
-    if(current_time > time[i]){
-      time_step = i;
-    }
-  }
-  if (current_time > time[time_vals - 1]){ //if the current time is larger than the last time step then there are no
-    more_time = false;                     //more time steps
-  }else more_time = true;
+  here.time = current_time;
+  FindTimeStep(here);
+
+  //when streaming, read the next time step in the background before we cross into it
+  if(stream_field && here.time_step + 2 < time_vals)
+    slice_cache.Prefetch(here.time_step + 2);
+  return true;
+}
+
+//---------------------------------------------------------------------
+//FindTimeStep
+// notes: finds the last time step before q.time and how far q.time is from it and the next one. a time before the
+//        first step is treated as being on it
+void USR_MOOSApp::FindTimeStep(USR_Query &q){
+  //time is increasing, so the last step before q.time is just ahead of the first step at or after it
+  q.time_step = lower_bound(&time[0], &time[0] + time_vals, q.time) - &time[0] - 1;
+  if(q.time_step < 0)
+    q.time_step = 0;
+
+  if (q.time > time[time_vals - 1] || time_vals < 2){ //if the current time is larger than the last time step then there are no
+    q.more_time = false;                            //more time steps
+  }else q.more_time = true;
   
-  if(more_time){   //if there are more time values we need to know how close we are to the closest two time steps
-    time_since = current_time - time[time_step];
-    time_until = time[time_step + 1] - current_time; 
+  if(q.more_time){   //if there are more time values we need to know how close we are to the closest two time steps
+    q.time_since = max(q.time - time[q.time_step], 0.0);
+    q.time_until = time[q.time_step + 1] - q.time; 
   }
-  return true;
 }
 
 //---------------------------------------------------------------------
 //GetValue
-//notes: gets values at both the two closest time steps and does an inverse weighted average on them
-double USR_MOOSApp::GetValue(){
-  double value;
-  if(more_time){  //if theres more time we need to interpolate over time
-    double val1 = GetValueAtTime(time_step);
-    double val2  = GetValueAtTime(time_step + 1);
-    
-    if (val1 == bad_val || val2 == bad_val){ // if either of the values are bad, return bad so we don't publish bad data
-      return bad_val;
+//notes: gets values at both the two closest time steps and does an inverse weighted average on them, for every
+//       scalar variable at once. values gets one entry per variable, returns false if a time step can't be read
+bool USR_MOOSApp::GetValue(USR_Query &q, double* values){
+  if(q.more_time){  //if theres more time we need to interpolate over time
+    q.val1.resize(NumVars());
+    q.val2.resize(NumVars());
+    double* val1 = &q.val1[0];
+    double* val2 = &q.val2[0];
+    if(!GetValueAtTime(q, q.time_step, val1) || !GetValueAtTime(q, q.time_step + 1, val2))
+      return false;
+
+    for(int v = 0; v < NumVars(); v++){
+      if (val1[v] == bad_val || val2[v] == bad_val){ // if either of the values are bad, return bad so we don't publish bad data
+	values[v] = bad_val;
+	continue;
+      }
+      double weights[2] = {q.time_since, q.time_until};
+      double pair[2] = {val1[v] , val2[v]};
+      int good[2] = {1, 1};
+      values[v] = WeightedAvg(pair , weights , good, 2);
     }
-    double weights[2] = {time_since, time_until};
-    double values[2] = {val1 , val2};
-    int good[2] = {1, 1};
-    value = WeightedAvg(values , weights , good, 2);
   }else{//if no future time values exist, just average the values around us at the most recent time step
-    value = GetValueAtTime(time_step);
-    if(!time_message_posted){
-      cout << "uSimROMS3: warning: current time is past the last time step, now using data only data from last time step" << endl;
-      time_message_posted = true; // we only want to give this warning once
-    }
+    if(!GetValueAtTime(q, q.time_step, values))
+      return false;
    }
-  return value;
+  return true;
 
 }
 //---------------------------------------------------------------------
 //GetValueAtTime
 //notes: takes the closest position, takes an inverse weighted averege (using distance as weights) the 8 closest 
-//      points, and spits out a value.
+//      points, and spits out a value for each scalar variable. the weights only depend on the position, depth and
+//      land mask, so they are worked out once and applied to every variable. the 4 water columns can come from
+//      up to 4 different tiles when tiling, land columns aren't read at all.
 // NJN: 2014/11/17: Added limiter to the above/below level grab. 
 // NJN: 2014/12/03: Modified for new sigma-level extraction, indexes good values
 //
-double USR_MOOSApp::GetValueAtTime(int t){
-
-  double dz[2] = {distSigma, distSp1};
-  double s_z[2] = {0, 0};
-  int good_z[2] = {0, 0};
-  double s_xy[4];
-  int good_xy[4]; //keeps track of how many good values we have so they don't skew the returned value
-  double value_t; // To be returned
-  
-  for(int k = 0; k < s_rho; k++){
-    //    cout << "i,j,k: " << closest_xi[0] << ", " << closest_eta[0] << ", " << k << "; salt: " << vals[t][k][closest_eta[0]][closest_xi[0]] << endl; 
+bool USR_MOOSApp::GetValueAtTime(USR_Query &q, int t, double* values){
+
+  //horizontal weights, land points (mask_rho = 0) get none. same inverse distance weighting as WeightedAvg()
+  double w_xy[4];
+  double sum_xy = 0;
+  for(int i = 0; i < 4; i++){
+    w_xy[i] = 0;
+    if (maskRho[Cell(q.eta[i], q.xi[i])])  // Check for Water = 1
+      w_xy[i] = 1 / ((q.dist[i] == 0) ? .000000001 : q.dist[i]);
+    sum_xy += w_xy[i];
   }
+
+  //vertical weights, a distance of -1 means that level isn't used
+  double dz[2] = {q.distSigma, q.distSp1};
+  double w_z[2];
+  double sum_z = 0;
   for(int k = 0; k < 2; k++){
-    // Initialize
+    w_z[k] = 0;
+    if (dz[k] != -1)
+      w_z[k] = 1 / ((dz[k] == 0) ? .000000001 : dz[k]);
+    sum_z += w_z[k];
+  }
+
+  //where the 4 columns start and how far apart their s levels are
+  USR_SlicePtr hold[4];
+  const double* column[4];
+  const float* column_f[4];
+  size_t level_stride[4];
+  for(int i = 0; i < 4; i++){
+    column[i] = NULL;
+    column_f[i] = NULL;
+    level_stride[i] = Cell(eta_rho, 0);
+  }
+  if(single_precision){
+    for(int i = 0; i < 4; i++)
+      column_f[i] = &vals_f[ValIndex(t, 0, 0, q.eta[i], q.xi[i])];
+  }else if(tile_field){
     for(int i = 0; i < 4; i++){
-      s_xy[i] = -1;
-      good_xy[i] = 0;
+      if(w_xy[i] == 0)
+	continue;
+      column[i] = TileColumn(t, q.eta[i], q.xi[i], hold[i], level_stride[i]);
+      if(column[i] == NULL){
+	cout << "uSimROMS3: unable to read the tile around " << q.eta[i] << ", " << q.xi[i] << " of time step " << t << endl;
+	return false;
+      }
+    }
+  }else{
+    const double* slice = TimeSlice(t, hold[0]);
+    if(slice == NULL){
+      cout << "uSimROMS3: unable to read time step " << t << endl;
+      return false;
+    }
+    for(int i = 0; i < 4; i++)
+      column[i] = slice + Cell(q.eta[i], q.xi[i]);
+  }
+
+  if(single_precision)
+    BlendSlice(column_f, level_stride, q, w_xy, sum_xy, w_z, sum_z, values);
+  else
+    BlendSlice(column, level_stride, q, w_xy, sum_xy, w_z, sum_z, values);
+
+  for(int v = 0; v < NumVars(); v++){
+    if (values[v] == bad_val){
+      cout << "uSimROMS3: Bad value of " << varNames[v] << " at time step " << t << endl;
     }
-    // Then make sure we want this level
-    if (dz[k] != -1){
-      // Find the four corners
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------
+//BlendSlice
+//notes: applies the weights from GetValueAtTime() to every variable of one time step. column[i] is where the
+//       (var, s) values of corner i start, level_stride[i] how far apart they are. the field is stored as
+//       double or, with SINGLE_PRECISION, as float, the sums are always done in double
+//
+template <class T>
+void USR_MOOSApp::BlendSlice(const T* column[4], const size_t level_stride[4], const USR_Query &q,
+			     const double w_xy[4], double sum_xy, const double w_z[2], double sum_z,
+			     double* values) const
+{
+  for(int v = 0; v < NumVars(); v++){
+    double value_t = 0;
+    for(int k = 0; k < 2; k++){
+      if (w_z[k] == 0)
+	continue;
+      double s_z = 0;
       for(int i = 0; i < 4; i++){
-	// Check for Water = 1
-	if (maskRho[closest_eta[i]][closest_xi[i]]){
-	  // Get the value
-	  s_xy[i] = vals[t][s_level + k][closest_eta[i]][closest_xi[i]];
-	  good_xy[i] = 1;
-	}
+	if (w_xy[i] != 0)
+	  s_z += w_xy[i] * double(column[i][(size_t(v) * s_rho + q.s_level + k) * level_stride[i]]);
       }
-      // Average this level
-      s_z[k] = WeightedAvg(s_xy, closest_distance, good_xy, 4); 
-      good_z[k] = 1;
+      value_t += w_z[k] * s_z / sum_xy;
     }
+    values[v] = value_t / sum_z;
+  }
+}
+
+//---------------------------------------------------------------------
+//TimeSlice
+//notes: returns the (var, s, eta, xi) block for time step t, either straight out of vals or, when streaming,
+//       from the slice cache. hold keeps a streamed slice alive while the caller uses it
+//
+const double* USR_MOOSApp::TimeSlice(int t, USR_SlicePtr &hold)
+{
+  if(!stream_field)
+    return &vals[ValIndex(t, 0, 0, 0, 0)];
+
+  hold = slice_cache.Get(t);
+  if(!hold)
+    return NULL;
+  return &(*hold)[0];
+}
+
+//---------------------------------------------------------------------
+//TileColumn
+//notes: returns where the values of cell (j, i) start in its tile of time step t, reading the tile if it isn't
+//       resident. level_stride gets the distance between s levels in that tile, hold keeps the tile alive
+//
+const double* USR_MOOSApp::TileColumn(int t, int j, int i, USR_SlicePtr &hold, size_t &level_stride)
+{
+  int tj = j / tile_size;
+  int ti = i / tile_size;
+  hold = tile_cache.Get(TileKey(t, tj, ti));
+  if(!hold)
+    return NULL;
+  level_stride = size_t(TileRows(tj)) * TileCols(ti);
+  return &(*hold)[size_t(j - tj * tile_size) * TileCols(ti) + (i - ti * tile_size)];
+}
+
+//---------------------------------------------------------------------
+//PrefetchTiles
+//notes: asks tile_cache to read in the background the tiles around the point tile_lookahead meters ahead, for the
+//       time steps in use now, and the tiles the vehicle is in for the step after those. called once a tick
+//
+void USR_MOOSApp::PrefetchTiles()
+{
+  if(here.time_step + 2 < time_vals){
+    for(int i = 0; i < 4; i++)
+      tile_cache.Prefetch(TileKey(here.time_step + 2, here.eta[i] / tile_size, here.xi[i] / tile_size));
   }
 
-  //cout << "uSR: s_z  " << s_z[0] << ", " << s_z[1] << endl;
-  //cout << "uSR: dz  " << dz[0] << ", " << dz[1] << endl;
-  //cout << "uSR: good_z  " << good_z[0] << ", " << good_z[1] << endl;
-  // Average the values at the two s_level
-  value_t = WeightedAvg(s_z , dz , good_z, 2);
-  if (value_t == bad_val){
-    cout << "uSimROMS3: Bad value at time step " << time_step << endl;
+  double headRad = (90 - m_head)/180*3.1415;
+  double chk_x = tile_lookahead*cos(headRad) + m_posx;
+  double chk_y = tile_lookahead*sin(headRad) + m_posy;
+  ahead_valid = LatLontoIndex(ahead_eta, ahead_xi, ahead_distance, chk_x, chk_y, ahead_valid);
+  if(!ahead_valid)
+    return;
+  int steps = here.more_time ? 2 : 1;
+  for(int n = here.time_step; n < here.time_step + steps; n++){
+    for(int i = 0; i < 4; i++)
+      tile_cache.Prefetch(TileKey(n, ahead_eta[i] / tile_size, ahead_xi[i] / tile_size));
   }
-  
-  return value_t;
 }
 
 //------------------------------------------------------------------
 //procedure : GetBathy
-//notes: gets the bathymetry at the current location. uses an inverse weighted average
+//notes: gets the bathymetry at the given 4 points. uses an inverse weighted average
 // NJN: 2014/12/03: Doesn't check for good values right now.
+//      land points (mask_rho = 0) are left out of the average, returns false if all 4 are land
 //
 bool USR_MOOSApp::GetBathy(int eta[4], int xi[4], double dist[4], double &depth)
 {
   double local_depths[4];
   int good[4];
+  int num_good = 0;
   for(int i = 0; i < 4; i++){
-    if (maskRho[eta[i]][xi[i]]){
-      local_depths[i] = bathy[eta[i]] [xi[i]];
+    local_depths[i] = 0;
+    good[i] = 0;
+    if (maskRho[Cell(eta[i], xi[i])]){
+      local_depths[i] = bathy[Cell(eta[i], xi[i])];
       good[i] = 1;
+      num_good++;
     }
   }
-  depth = WeightedAvg(local_depths, closest_distance, good, 4);
+  if(num_good == 0)
+    return false;
+  depth = WeightedAvg(local_depths, dist, good, 4);
+  return true;
 }
 
 
 //---------------------------------------------------------------------
 //procedure: GetSafeDepth
 //notes:interpolates the current best guess altitude with each of the 4 closest bathymetry points, it then returns the smallest depth found 
+//      returns false if the look forward point is off the grid. land ahead gives a safe depth of 0
 //
 bool USR_MOOSApp::GetSafeDepth()
 { 
-  int chk_x, chk_y;
-  int chk_eta[4];
-  int chk_xi[4];
-  double chk_dist[4];
+  double chk_x, chk_y;
   double headRad = (90 - m_head)/180*3.1415; // convert from geo to math coords, then to radians
   chk_x = look_fwd*cos(headRad) + m_posx;
   chk_y = look_fwd*sin(headRad) + m_posy;
-  LatLontoIndex(chk_eta, chk_xi, chk_dist, chk_x, chk_y);
-  GetBathy(chk_eta, chk_xi, chk_dist, safe_depth);
+  fwd_valid = LatLontoIndex(fwd_eta, fwd_xi, fwd_distance, chk_x, chk_y, fwd_valid);
+  if(!fwd_valid)
+    return false;
+  if(!GetBathy(fwd_eta, fwd_xi, fwd_distance, safe_depth))
+    safe_depth = 0;
+  return true;
   //cout << "Local bathy depth = " << floor_depth << endl;
   //cout << "Depth at " << look_fwd << " m ahead is " << safe_depth << endl;
       
@@ -609,21 +995,64 @@ double USR_MOOSApp::WeightedAvg(double* values, double* weights, int* good, int
 }
 
 //---------------------------------------------------------------------
-//ConvertToMeters : converts the entire lat/lon grid in order to populate the northings and eastings grid
+//ConvertToMeters : converts the entire lat/lon grid in order to populate the northings and eastings grid. rows are
+//                  split over all cores. with FAST_CONVERT the grid goes through a USR_GridFit instead of geodesy,
+//                  as long as the fit agrees with geodesy to within CONVERT_TOLERANCE meters
 //
 bool USR_MOOSApp::ConvertToMeters()
 {
-  meters_n = new double *[eta_rho];
-  meters_e = new double *[eta_rho];
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  meters_n.resize(Cell(eta_rho, 0));
+  meters_e.resize(Cell(eta_rho, 0));
+
+  //LatLong2LocalGrid only reads the origin, so rows can be converted at the same time
+  USR_GridFit::Exact exact = [this](double la, double lo, double &n, double &e){
+    geodesy.LatLong2LocalGrid(la, lo, n, e);
+  };
+
+  USR_GridFit fit;
+  bool fast = fast_convert && FitGrid(fit, exact);
+  int threads = USR_ParallelFor(eta_rho, 0, [&](int begin, int end){
+      for(int j = begin; j < end; j++){
+	if(fast)
+	  fit.Convert(&lat[Cell(j, 0)], &lon[Cell(j, 0)], xi_rho, &meters_n[Cell(j, 0)], &meters_e[Cell(j, 0)]);
+	else{
+	  for(int i = 0; i < xi_rho; i++)
+	    exact(lat[Cell(j, i)], lon[Cell(j, i)], meters_n[Cell(j, i)], meters_e[Cell(j, i)]);
+	}
+      }
+    });
+
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "uSimROMS3: converted " << eta_rho << "x" << xi_rho << " grid to meters (" << (fast ? "fitted" : "geodesy")
+       << ") on " << threads << " threads in " << secs * 1000 << " ms" << endl;
+  return true;
+}
 
-  for(int j = 0; j < eta_rho; j++){
-    meters_e[j] = new double[xi_rho];
-    meters_n[j] = new double[xi_rho];
+//---------------------------------------------------------------------
+//FitGrid : fits the conversion on every few hundredth grid point and the corners, then checks it against geodesy on
+//          the points halfway between those. returns false if the fit is off by more than convert_tol anywhere
+//
+bool USR_MOOSApp::FitGrid(USR_GridFit &fit, USR_GridFit::Exact exact)
+{
+  size_t cells = Cell(eta_rho, 0);
+  size_t stride = max<size_t>(cells / 4096, 2);
+  vector<size_t> sample, check;
+  for(size_t c = 0; c < cells; c += stride){
+    sample.push_back(c);
+    if(c + stride / 2 < cells)
+      check.push_back(c + stride / 2);
   }
-  
-  for(int j = 0; j < eta_rho; j++){
-    for(int i = 0; i < xi_rho; i++){
-      geodesy.LatLong2LocalGrid(lat[j][i], lon[j][i], meters_n[j][i], meters_e[j][i]);
-    }
+  sample.push_back(Cell(0, xi_rho - 1));
+  sample.push_back(Cell(eta_rho - 1, 0));
+  sample.push_back(cells - 1);
+
+  if(!fit.Fit(&lat[0], &lon[0], sample, lat_origin, long_origin, exact)){
+    cout << "uSimROMS3: can't fit the grid conversion, using geodesy" << endl;
+    return false;
   }
+  double max_err = fit.MaxError(&lat[0], &lon[0], check, exact);
+  cout << "uSimROMS3: fitted grid conversion is within " << max_err << " m of geodesy at " << check.size()
+       << " checked points" << ((max_err > convert_tol) ? ", too far off, using geodesy" : "") << endl;
+  return(max_err <= convert_tol);
 }
@@ -12,13 +12,21 @@
 #include <iostream>
 #include <cmath>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include "USR_GridIndex.h"
+#include "USR_SliceCache.h"
+#include "USR_FieldCache.h"
+#include "USR_Array.h"
+#include "USR_Query.h"
+#include "USR_GridFit.h"
 
 
 class USR_MOOSApp : public CMOOSApp  
 {
 public:
   USR_MOOSApp();
-  virtual ~USR_MOOSApp() {};
+  virtual ~USR_MOOSApp();
 
   bool Iterate();
   bool OnConnectToServer();
@@ -26,32 +34,76 @@ public:
   bool OnStartUp();
   bool OnNewMail(MOOSMSG_LIST &NewMail);
 
+  //loads the fields into shared memory and waits for a signal, for vehicles with SHARED_FIELD to attach to
+  bool RunServer(std::string mission_file, std::string app_name);
+  //samples the fields along a file of points without a MOOSDB, see USR_Batch.cpp
+  bool RunBatch(std::string mission_file, std::string app_name, std::string in_file,
+		std::string out_file, int threads);
+
  protected:
   void registerVariables();
+  bool Configure(std::string app_name);
   bool ReadNcFile(); //this is defined in a seperate file 
-  bool LatLontoIndex(int eta[4], int xi[4], double dist[4], double, double);
+  template <class T> bool ReadFieldSlice(NcVar* var, int n, T* dest);
+  template <class T> bool ReadTimeStep(const std::vector<NcVar*> &vars, int n, T* dest);
+  bool ReadTile(const std::vector<NcVar*> &vars, int key, double* dest);
+  bool LoadFieldCache(const std::string &name, bool shm, bool* missing = NULL); //these are in USR_FieldCache.cpp
+  bool WriteFieldImage(FILE* fp, bool ready, uint64_t &bytes);
+  std::string GridNames() const;
+  bool SaveFieldCache();
+  bool ServeSharedField();
+  bool AttachSharedField();
+  bool LatLontoIndex(int eta[4], int xi[4], double dist[4], double, double, bool use_prev = false);
   bool LatlontoMeters();
-  bool GetS_rho();
-  double GetValue();
-  double GetValueAtTime(int);
+  bool GetS_rho(USR_Query &q);
+  void BuildDepthTable();
+  bool Sample(USR_Query &q, double* values);
+  bool GetValue(USR_Query &q, double* values);
+  bool GetValueAtTime(USR_Query &q, int t, double* values);
+  template <class T> void BlendSlice(const T* column[4], const size_t level_stride[4], const USR_Query &q,
+				     const double w_xy[4], double sum_xy, const double w_z[2], double sum_z,
+				     double* values) const;
+  const double* TimeSlice(int n, USR_SlicePtr &hold);
+  const double* TileColumn(int n, int j, int i, USR_SlicePtr &hold, size_t &level_stride);
+  void PrefetchTiles();
   double WeightedAvg(double*,double*, int*, int);
   bool GetTimeInfo();
+  void FindTimeStep(USR_Query &q);
   bool GetBathy(int eta[4], int xi[4], double dist[4], double &depth);
   bool GetSafeDepth();
   bool ConvertToMeters();
+  bool FitGrid(USR_GridFit &fit, USR_GridFit::Exact exact);
+  void ReportMemory();
+
+  //offsets into the flat storage below
+  int NumVars() const {return(varNames.size());}
+  size_t ValIndex(int n, int v, int k, int j, int i) const
+    {return((((size_t(n) * varNames.size() + v) * s_rho + k) * eta_rho + j) * xi_rho + i);}
+  size_t Cell(int j, int i) const
+    {return(size_t(j) * xi_rho + i);}
+  //tiles are tile_size x tile_size cells, the last row and column of tiles can be smaller. a tile of one time
+  //step holds every variable and s level of its cells, laid out (var, s, eta, xi) like a time slice
+  int TileKey(int n, int tj, int ti) const
+    {return((n * tiles_eta + tj) * tiles_xi + ti);}
+  int TileRows(int tj) const
+    {return(std::min(tile_size, eta_rho - tj * tile_size));}
+  int TileCols(int ti) const
+    {return(std::min(tile_size, xi_rho - ti * tile_size));}
   
 
  protected: // Configuration variables
   std::string ncFileName;
-  std::string varName; 
+  std::vector<std::string> varNames; //scalar variables, all sampled with the same grid lookup
   std::string maskRhoVarName;
   std::string latVarName;
   std::string lonVarName;
   std::string timeVarName;
   std::string sVarName;
   std::string bathyVarName;
-  std::string scalarOutputVar;
+  std::vector<std::string> scalarOutputVars; //what each of varNames is published as
   std::string safeDepthVar;
+  std::string field_cache_file; //preprocessed copy of the nc file, see USR_FieldCache.h
+  std::string shared_field; //name of the POSIX shared memory object holding the same image
 
   int time_vals; //number of time vals
   int s_rho;  //number of s_rho points
@@ -65,61 +117,96 @@ public:
   bool xi_override;
   
   bool bathy_only;
+  bool local_search; //start each grid search from the previous answer
+  bool stream_field; //only keep a few time slices of the field in memory
+  int  resident_slices; //most time slices held at once when streaming
+  bool single_precision; //field values are kept in vals_f instead of vals
+  bool fast_convert; //use a USR_GridFit in ConvertToMeters when it is accurate enough
+  double convert_tol; //meters
+  bool field_server; //load the field and publish it as shared_field for the other instances
+  double shared_wait; //seconds a client waits for the server to publish shared_field
+  bool tile_field; //only keep tiles of the field near the vehicle in memory
+  int  tile_size; //cells along each side of a tile
+  int  resident_tiles; //most tiles held at once
+  double tile_lookahead; //meters ahead of the vehicle to read tiles in before it gets there
 
  protected: // State variables
 
-  double start_time;
-  double current_time;
-
   // x/y positions, dpeth, and altitude of current location 
   double       m_posx;
   double       m_posy;
   double       m_depth;
   double       m_head;
   std::string  m_rTime;
-  double       floor_depth;
   double       look_fwd; //distance forward (in meters) to check for dangerous bathymetry
   double       safe_depth; //deepest safe depth based on the distance in safe_dist
   double       m_altitude;    
 
-  //current depth level, and distances to nearest s_levels
-  int          s_level;
-  double       distSigma;
-  double       distSp1;
-  bool         above_s_level;
-  
-  //closest 4 eta/xi pairs(so closest_eta[0] and closest_xi[0] form one pair)and the respecitve distances to them
-  int          closest_eta[4];
-  int          closest_xi[4];
-  double       closest_distance[4];
-  double       closest_dist_meters[4];
+  //the vehicle's sample: closest 4 eta/xi pairs (here.eta[0] and here.xi[0] form one pair) and the respective
+  //distances to them, the floor depth, the nearest s levels and time steps. kept between ticks
+  USR_Query    here;
+
+  //closest 4 eta/xi pairs for the look forward point used by GetSafeDepth
+  int          fwd_eta[4];
+  int          fwd_xi[4];
+  double       fwd_distance[4];
+  bool         fwd_valid;
   
   //our current lon/lat coordinate
   double       current_lat;
   double       current_lon;
 
-  //the current time step, as well as the time from it and the time until the next one
-  int          time_step;
-  double       time_until;
-  double       time_since;
-  bool         more_time;
   bool         time_message_posted;
 
   //the value represnting a nonexistent value
   double       bad_val;
-  //geodesy class
+  //this tick's value of each scalar variable
+  std::vector<double> var_values;
+  //geodesy class and the origin it was set up with
   CMOOSGeodesy geodesy;
+  double       lat_origin;
+  double       long_origin;
   
-  //stores variables from the CDF file
-  double****   vals;
-  int**        maskRho;
-  double**     lat;
-  double**     lon;
-  double**     meters_n;
-  double**     meters_e;
-  double**     bathy;
-  double*      time;
-  double*      s_values;
+  //stores variables from the CDF file. the scalar fields are one contiguous (time, var, s, eta, xi) block
+  //indexed with ValIndex(), so one time step of every variable sits together, the 2-D grids are (eta, xi) blocks indexed with Cell(). these either own
+  //their values or point into the mapped field cache
+  USR_Array<double> vals;
+  USR_Array<float>  vals_f;
+  USR_Array<int>    maskRho;
+  USR_Array<double> lat;
+  USR_Array<double> lon;
+  USR_Array<double> meters_n;
+  USR_Array<double> meters_e;
+  USR_Array<double> bathy;
+  USR_Array<double> time;
+  USR_Array<double> s_values;
+  USR_MappedFile    field_cache;
+  std::string       field_cache_name; //what field_cache is a mapping of
+  bool              shared_owner; //this instance created shared_field and removes it on exit
+
+  //depth of each s level as a fraction of the water column (-s_values), built once by BuildDepthTable().
+  //ROMS s levels run bottom to surface so this is decreasing when s_sorted is set
+  std::vector<double> s_frac;
+  bool                s_sorted;
+
+  //when streaming, time slices of the fields come from slice_cache instead of vals
+  NcFile*              stream_file;
+  std::vector<NcVar*>  stream_vars;
+  USR_SliceCache       slice_cache;
+
+  //when tiling, tiles of the fields come from tile_cache, keyed by TileKey(). lat/lon are let go once converted
+  //to meters, but meters_n/e, bathy, maskRho and the grid index stay resident, about 48 bytes per grid cell
+  int                  tiles_eta;
+  int                  tiles_xi;
+  USR_SliceCache       tile_cache;
+  //closest 4 eta/xi pairs for the point tile_lookahead ahead, used by PrefetchTiles
+  int                  ahead_eta[4];
+  int                  ahead_xi[4];
+  double               ahead_distance[4];
+  bool                 ahead_valid;
+
+  //spatial index over meters_n/meters_e, used by LatLontoIndex
+  USR_GridIndex grid_index;
   
 
 
@@ -0,0 +1,35 @@
+//---------------------------------------------------------------------
+// USR_ParallelFor: splits [0, n) into one contiguous run per thread and
+// calls work(begin, end) on each, returning once they are all done.
+// threads <= 0 uses every core. used for the startup passes over the
+// grid, the work for different runs must not write to the same memory.
+
+#ifndef USR_PARALLEL_HEADER
+#define USR_PARALLEL_HEADER
+
+#include <vector>
+#include <thread>
+#include <functional>
+
+inline int USR_ParallelFor(int n, int threads, std::function<void(int begin, int end)> work)
+{
+  if(threads <= 0)
+    threads = std::thread::hardware_concurrency();
+  if(threads > n)
+    threads = n;
+  if(threads <= 1){
+    if(n > 0)
+      work(0, n);
+    return(1);
+  }
+
+  std::vector<std::thread> workers;
+  for(int t = 1; t < threads; t++)
+    workers.push_back(std::thread(work, int(long(n) * t / threads), int(long(n) * (t + 1) / threads)));
+  work(0, int(long(n) / threads));  // this thread takes the first run
+  for(unsigned int t = 0; t < workers.size(); t++)
+    workers[t].join();
+  return(threads);
+}
+
+#endif
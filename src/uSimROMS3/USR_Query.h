@@ -0,0 +1,52 @@
+//---------------------------------------------------------------------
+// USR_Query: everything worked out while sampling the ROMS fields at one
+// (time, x, y, depth) point. the sampling functions in USR_MOOSApp only
+// read shared data and write into the query, so several threads can
+// sample at once as long as each uses its own query. reusing a query for
+// the next point along the same track lets the grid lookup walk from the
+// last answer instead of searching the whole grid.
+
+#ifndef USR_QUERY_HEADER
+#define USR_QUERY_HEADER
+
+#include <vector>
+
+struct USR_Query
+{
+  USR_Query() : x(0), y(0), depth(0), time(0), valid(false), floor_depth(0),
+		s_level(0), distSigma(-1), distSp1(-1),
+		time_step(0), time_since(0), time_until(0), more_time(false) {}
+
+  // where and when to sample: local grid meters, meters down, unix seconds
+  double x;
+  double y;
+  double depth;
+  double time;
+
+  // closest 4 eta/xi pairs and their distances, valid if they are the
+  // answer for the last point sampled with this query
+  int    eta[4];
+  int    xi[4];
+  double dist[4];
+  bool   valid;
+
+  // interpolated bathymetry and the two s levels around depth
+  double floor_depth;
+  int    s_level;
+  double distSigma;
+  double distSp1;
+
+  // the time step before time, and the time from it and until the next one
+  int    time_step;
+  double time_since;
+  double time_until;
+  bool   more_time;
+
+  // one value per variable at each of the two time steps, for GetValue().
+  // kept here so every thread has its own and a reused query allocates
+  // nothing after its first point
+  std::vector<double> val1;
+  std::vector<double> val2;
+};
+
+#endif
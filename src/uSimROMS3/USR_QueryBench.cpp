@@ -0,0 +1,226 @@
+//---------------------------------------------------------------------
+// USR_QueryBench: times the per-tick work of uSimROMS3 (LatLontoIndex,
+// GetValue and GetSafeDepth) on a synthetic ROMS field, so lookup and
+// interpolation cost can be measured without a ROMS file or a MOOSDB.
+// the grid is a rotated, bending curvilinear grid with an island and a
+// coastline in the mask, sloping bathymetry, evenly spaced s levels and
+// hourly time steps.
+//
+// queries run along random points of the grid and along vehicle-like
+// tracks (1.5 m/s at 4 Hz with slow turns), latencies are reported as
+// percentiles per call along with the memory the fields take up.
+//
+// usage: uSimROMS3_QueryBench [eta_rho] [xi_rho] [s_rho] [time_vals] [queries]
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+#include "USR_MOOSApp.h"
+#include "USR_SyntheticGrid.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// USR_BenchApp: gives the benchmark access to the app's sampling code
+
+class USR_BenchApp : public USR_MOOSApp
+{
+public:
+  void MakeField(int eta, int xi, int s, int t);
+  void Run(const string &name, const vector<double> &x, const vector<double> &y,
+	   const vector<double> &head, bool use_prev);
+  void RandomPoints(int n, vector<double> &x, vector<double> &y, vector<double> &head);
+  void Track(int n, vector<double> &x, vector<double> &y, vector<double> &head);
+  void Memory() {ReportMemory();}
+};
+
+//---------------------------------------------------------------------
+// Procedure: MakeField
+
+void USR_BenchApp::MakeField(int eta, int xi, int s, int t)
+{
+  eta_rho = eta;
+  xi_rho = xi;
+  s_rho = s;
+  time_vals = t;
+  varNames.assign(1, "salt");
+  scalarOutputVars.assign(1, "SCALAR_VALUE");
+  var_values.assign(1, bad_val);
+
+  size_t cells = Cell(eta_rho, 0);
+  lat.assign(cells, 0);
+  lon.assign(cells, 0);
+  meters_n.resize(cells);
+  meters_e.resize(cells);
+  USR_SyntheticGrid(eta_rho, xi_rho, &meters_n[0], &meters_e[0]);
+
+  // land along the top edge and a round island in the middle
+  maskRho.assign(cells, 1);
+  bathy.assign(cells, 0);
+  for(int j = 0; j < eta_rho; j++){
+    for(int i = 0; i < xi_rho; i++){
+      double di = i - xi_rho / 2.0, dj = j - eta_rho / 2.0;
+      bool land = (j > eta_rho * 0.95) || (di * di + dj * dj < 0.01 * xi_rho * eta_rho);
+      maskRho[Cell(j, i)] = land ? 0 : 1;
+      bathy[Cell(j, i)] = 5 + 300.0 * (1 - double(j) / eta_rho) + 20 * sin(i / 40.0);
+    }
+  }
+
+  s_values.assign(s_rho, 0);
+  for(int k = 0; k < s_rho; k++)
+    s_values[k] = -1 + (k + 0.5) / s_rho;
+  time.assign(time_vals, 0);
+  for(int n = 0; n < time_vals; n++)
+    time[n] = 1.5e9 + 3600.0 * n;
+
+  vals.assign(ValIndex(time_vals, 0, 0, 0, 0), 0);
+  for(int n = 0; n < time_vals; n++)
+    for(int k = 0; k < s_rho; k++)
+      for(int j = 0; j < eta_rho; j++)
+	for(int i = 0; i < xi_rho; i++)
+	  vals[ValIndex(n, 0, k, j, i)] = 30 + sin(i / 25.0 + n * 0.1) + 0.5 * cos(j / 30.0) - k * 0.05;
+
+  BuildDepthTable();
+  grid_index.Build(&meters_n[0], &meters_e[0], eta_rho, xi_rho);
+}
+
+//---------------------------------------------------------------------
+// Procedure: RandomPoints
+// notes : jittered grid points anywhere on the grid, every query is a jump
+
+void USR_BenchApp::RandomPoints(int n, vector<double> &x, vector<double> &y, vector<double> &head)
+{
+  mt19937 rng(12345);
+  uniform_int_distribution<int> pick_j(0, eta_rho - 1);
+  uniform_int_distribution<int> pick_i(0, xi_rho - 1);
+  uniform_real_distribution<double> jitter(-150.0, 150.0);
+  uniform_real_distribution<double> pick_head(0, 360);
+  for(int q = 0; q < n; q++){
+    int j = pick_j(rng), i = pick_i(rng);
+    x.push_back(meters_e[Cell(j, i)] + jitter(rng));
+    y.push_back(meters_n[Cell(j, i)] + jitter(rng));
+    head.push_back(pick_head(rng));
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: Track
+// notes : a vehicle at 1.5 m/s sampled at 4 Hz, turning every few minutes,
+//         starting in the middle of the lower half of the grid
+
+void USR_BenchApp::Track(int n, vector<double> &x, vector<double> &y, vector<double> &head)
+{
+  mt19937 rng(54321);
+  uniform_real_distribution<double> turn(-90, 90);
+  double tx = meters_e[Cell(eta_rho / 4, xi_rho / 2)];
+  double ty = meters_n[Cell(eta_rho / 4, xi_rho / 2)];
+  double h = 45;
+  for(int q = 0; q < n; q++){
+    if(q % 800 == 0)
+      h += turn(rng);
+    double rad = (90 - h) / 180 * M_PI;
+    tx += 1.5 / 4 * cos(rad);
+    ty += 1.5 / 4 * sin(rad);
+    x.push_back(tx);
+    y.push_back(ty);
+    head.push_back(h);
+  }
+}
+
+//---------------------------------------------------------------------
+// Procedure: Percentiles
+
+static void Percentiles(const string &name, vector<double> &ns)
+{
+  if(ns.empty())
+    return;
+  sort(ns.begin(), ns.end());
+  double pct[] = {50, 90, 99, 99.9};
+  cout << "  " << setw(14) << left << name << right;
+  for(int p = 0; p < 4; p++)
+    cout << "  p" << pct[p] << " " << setw(8) << ns[min(ns.size() - 1, size_t(ns.size() * pct[p] / 100))];
+  cout << "  max " << setw(8) << ns.back() << "  ns" << endl;
+}
+
+//---------------------------------------------------------------------
+// Procedure: Run
+// notes : the same steps Iterate() takes, each timed on its own
+
+void USR_BenchApp::Run(const string &name, const vector<double> &x, const vector<double> &y,
+		       const vector<double> &head, bool use_prev)
+{
+  vector<double> t_index, t_value, t_safe;
+  USR_Query q;
+  q.valid = fwd_valid = false;
+  local_search = use_prev;
+  int off_grid = 0;
+  for(unsigned int p = 0; p < x.size(); p++){
+    q.x = m_posx = x[p];
+    q.y = m_posy = y[p];
+    q.depth = m_depth = 10;
+    m_head = head[p];
+    q.time = time[0] + (time[time_vals - 1] - time[0]) * p / x.size();
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    q.valid = LatLontoIndex(q.eta, q.xi, q.dist, q.x, q.y, q.valid);
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    t_index.push_back(chrono::duration<double, nano>(t1 - t0).count());
+    if(!q.valid || !GetBathy(q.eta, q.xi, q.dist, q.floor_depth)){
+      off_grid++;
+      continue;
+    }
+
+    t0 = chrono::steady_clock::now();
+    GetS_rho(q);
+    FindTimeStep(q);
+    GetValue(q, &var_values[0]);
+    t1 = chrono::steady_clock::now();
+    t_value.push_back(chrono::duration<double, nano>(t1 - t0).count());
+
+    t0 = chrono::steady_clock::now();
+    GetSafeDepth();
+    t1 = chrono::steady_clock::now();
+    t_safe.push_back(chrono::duration<double, nano>(t1 - t0).count());
+  }
+
+  cout << name << " (" << x.size() << " queries, " << off_grid << " off the grid or on land)" << endl;
+  Percentiles("LatLontoIndex", t_index);
+  Percentiles("GetValue", t_value);
+  Percentiles("GetSafeDepth", t_safe);
+}
+
+int main(int argc, char* argv[])
+{
+  int eta_rho   = (argc > 1) ? atoi(argv[1]) : 1000;
+  int xi_rho    = (argc > 2) ? atoi(argv[2]) : 800;
+  int s_rho     = (argc > 3) ? atoi(argv[3]) : 30;
+  int time_vals = (argc > 4) ? atoi(argv[4]) : 4;
+  int queries   = (argc > 5) ? atoi(argv[5]) : 100000;
+
+  USR_BenchApp app;
+  chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+  app.MakeField(eta_rho, xi_rho, s_rho, time_vals);
+  double setup_s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+  cout << "field: " << time_vals << " x " << s_rho << " x " << eta_rho << " x " << xi_rho
+       << ", built in " << setup_s << " s" << endl;
+
+  vector<double> x, y, head;
+  app.RandomPoints(queries, x, y, head);
+  app.Run("random points, global search", x, y, head, false);
+
+  x.clear(); y.clear(); head.clear();
+  app.Track(queries, x, y, head);
+  app.Run("vehicle track, walking from the last cell", x, y, head, true);
+  app.Run("vehicle track, global search", x, y, head, false);
+
+  app.Memory();
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  cout << "peak resident set: " << usage.ru_maxrss / 1024.0 << " MB" << endl;
+  return(0);
+}
@@ -1,6 +1,98 @@
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <climits>
 #include "USR_MOOSApp.h"
 using namespace std;
 
+//---------------------------------------------------------------------
+// Procedure: ReadGrid
+// notes : reads an (eta, xi) variable into a flat array with one hyperslab call, falling back to reading
+//         it row by row if the library refuses the bulk read
+
+template <class T>
+static bool ReadGrid(NcVar* var, T* dest, int eta_rho, int xi_rho)
+{
+  var->set_cur(0, 0);
+  if(var->get(dest, eta_rho, xi_rho))
+    return true;
+
+  for(int j = 0; j < eta_rho; j++){
+    var->set_cur(j, 0);
+    if(!var->get(dest + size_t(j) * xi_rho, 1, xi_rho))
+      return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: ReadFieldSlice
+// notes : reads time step n of the scalar variable, all (s, eta, xi) values, into dest with one hyperslab
+//         call. the old row by row read (time*s*eta separate netCDF calls) is only used as a fallback.
+//         dest is double, or float with SINGLE_PRECISION, the netCDF library converts as it reads
+
+template <class T>
+bool USR_MOOSApp::ReadFieldSlice(NcVar* var, int n, T* dest)
+{
+  var->set_cur(n, 0, 0, 0);
+  if(var->get(dest, 1, s_rho, eta_rho, xi_rho))
+    return true;
+
+  for(int k = 0; k < s_rho; k++){
+    for(int j = 0; j < eta_rho; j++){
+      var->set_cur(n, k, j, 0);
+      if(!var->get(dest + ValIndex(0, 0, k, j, 0), 1, 1, 1, xi_rho))
+	return false;
+    }
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: ReadTimeStep
+// notes : reads time step n of every scalar variable into dest, laid out (var, s, eta, xi) like one time step of vals
+
+template <class T>
+bool USR_MOOSApp::ReadTimeStep(const vector<NcVar*> &vars, int n, T* dest)
+{
+  for(unsigned int v = 0; v < vars.size(); v++){
+    if(!ReadFieldSlice(vars[v], n, dest + ValIndex(0, v, 0, 0, 0)))
+      return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------
+// Procedure: ReadTile
+// notes : reads the tile TileKey() calls key, every variable and s level of its cells at its time step, into
+//         dest laid out (var, s, eta, xi) with the tile's own rows and columns. one hyperslab call per variable,
+//         row by row as a fallback
+
+bool USR_MOOSApp::ReadTile(const vector<NcVar*> &vars, int key, double* dest)
+{
+  int ti = key % tiles_xi;
+  int tj = (key / tiles_xi) % tiles_eta;
+  int n  = key / tiles_xi / tiles_eta;
+  int rows = TileRows(tj);
+  int cols = TileCols(ti);
+  size_t level = size_t(rows) * cols;
+
+  for(unsigned int v = 0; v < vars.size(); v++){
+    double* var_dest = dest + size_t(v) * s_rho * level;
+    vars[v]->set_cur(n, 0, tj * tile_size, ti * tile_size);
+    if(vars[v]->get(var_dest, 1, s_rho, rows, cols))
+      continue;
+    for(int k = 0; k < s_rho; k++){
+      for(int j = 0; j < rows; j++){
+	vars[v]->set_cur(n, k, tj * tile_size + j, ti * tile_size);
+	if(!vars[v]->get(var_dest + k * level + size_t(j) * cols, 1, 1, 1, cols))
+	  return false;
+      }
+    }
+  }
+  return true;
+}
+
 //TODO : break this up into smaller functions (in a way that does NOT break everything horribly)
 
 //---------------------------------------------------------------------
@@ -25,18 +117,21 @@ bool USR_MOOSApp::ReadNcFile()
       return false;
     } else cout <<"uSimROMS3: file opened successfully" << endl;
 
-  //find specified variable
-  NcVar* scalar_var = File.get_var((const char*) varName.c_str());
-  if(!(scalar_var->is_valid())) //check if variable was valid
-    {
-      cout << "uSimROMS3: error reading scalar variable" << endl;
-      return false;
-    }else cout << "uSimROMS3: variable \"" << varName << "\" found" << endl; 
+  //find specified variables
+  vector<NcVar*> scalar_vars(NumVars());
+  for(int v = 0; v < NumVars(); v++){
+    scalar_vars[v] = File.get_var((const char*) varNames[v].c_str());
+    if(scalar_vars[v] == NULL || !(scalar_vars[v]->is_valid())) //check if variable was valid
+      {
+	cout << "uSimROMS3: error reading scalar variable \"" << varNames[v] << "\"" << endl;
+	return false;
+      }else cout << "uSimROMS3: variable \"" << varNames[v] << "\" found" << endl; 
+  }
 
   
-  //get the size of the array our variable is stored in, edge lengths apply to lat/lon and time variables too
+  //get the size of the array our variables are stored in, edge lengths apply to lat/lon and time variables too
    long* edge;
-   edge =  scalar_var->edges();
+   edge =  scalar_vars[0]->edges();
    if(time_override == false){ 
      time_vals = edge[0];
      cout << "uSimROMS3: using "  << time_vals << " time values"  << endl;
@@ -53,6 +148,20 @@ bool USR_MOOSApp::ReadNcFile()
      xi_rho = edge[3];
      cout << "uSimROMS3: using " << xi_rho << " xi_values" << endl;
    }
+   //every variable shares the one grid lookup, so they have to be on the same grid
+   for(int v = 1; v < NumVars(); v++){
+     long* v_edge = scalar_vars[v]->edges();
+     bool same = true;
+     for(int d = 0; d < 4; d++)
+       same = same && (v_edge[d] == edge[d]);
+     delete [] v_edge;
+     if(!same){
+       cout << "uSimROMS3: \"" << varNames[v] << "\" is not the same size as \"" << varNames[0] << "\", exiting" << endl;
+       delete [] edge;
+       return false;
+     }
+   }
+   delete [] edge;
   
   //find mask_rho variable
   NcVar* maskRho_var = File.get_var((const char*) maskRhoVarName.c_str()); 
@@ -103,83 +212,93 @@ bool USR_MOOSApp::ReadNcFile()
     }else cout << "uSimROMS3: bathymetry variable found" << endl;
   
   
-  //create a value array in local memory, read in scalar values
-  vals = new double***[time_vals];
-  for(int n = 0; n < time_vals; n++)  //dynamic memory must be initialized row by row
-    {
-      vals[n] = new double**[s_rho];
-      for(int k = 0; k < s_rho; k++)
-	{
-	  vals[n][k] = new double*[eta_rho];
-	  for(int j = 0; j < eta_rho; j++)
-	    {
-	      vals[n][k][j] = new double[xi_rho];
-	    }
-	}
+  if(stream_field || tile_field){
+    //leave the field on disk, time slices or tiles are read through slice_cache or tile_cache as GetValue()
+    //needs them. that needs a file handle that outlives this function
+    stream_file = new NcFile((const char*)ncFileName.c_str(), NcFile::ReadOnly , buffer , size , NcFile::Netcdf4);
+    stream_vars.assign(NumVars(), NULL);
+    for(int v = 0; v < NumVars(); v++){
+      if(stream_file->is_valid())
+	stream_vars[v] = stream_file->get_var((const char*) varNames[v].c_str());
+      if(stream_vars[v] == NULL || !stream_vars[v]->is_valid()){
+	cout << "uSimROMS3: error opening \"" << varNames[v] << "\" for streaming" << endl;
+	return false;
+      }
     }
+  }
+  if(tile_field){
+    tiles_eta = (eta_rho + tile_size - 1) / tile_size;
+    tiles_xi  = (xi_rho + tile_size - 1) / tile_size;
+    if(double(time_vals) * tiles_eta * tiles_xi > INT_MAX){
+      cout << "uSimROMS3: too many tiles, use a larger TILE_SIZE" << endl;
+      return false;
+    }
+    tile_cache.Start(bind(&USR_MOOSApp::ReadTile, this, stream_vars, placeholders::_1, placeholders::_2),
+		     size_t(NumVars()) * s_rho * tile_size * tile_size, resident_tiles);
+    cout << "uSimROMS3: tiling " << NumVars() << " variable(s) into " << tiles_eta << "x" << tiles_xi << " tiles of "
+	 << tile_size << " cells, at most " << tile_cache.Capacity() << " tiles (" << tile_cache.SliceBytes() / 1e6
+	 << " MB each) in memory" << endl;
+  }
+  else if(stream_field){
+    slice_cache.Start(bind(&USR_MOOSApp::ReadTimeStep<double>, this, stream_vars, placeholders::_1, placeholders::_2),
+		      ValIndex(1, 0, 0, 0, 0), resident_slices);
+    cout << "uSimROMS3: streaming " << NumVars() << " variable(s), at most " << slice_cache.Capacity() << " of "
+	 << time_vals << " time slices (" << slice_cache.SliceBytes() / 1e6 << " MB each) in memory" << endl;
+  }
+  else{
+    //create a value array in local memory, read in scalar values. all the fields are one contiguous
+    //(time, var, s, eta, xi) block, see ValIndex(). with SINGLE_PRECISION it's vals_f instead of vals
+    if(single_precision)
+      vals_f.assign(ValIndex(time_vals, 0, 0, 0, 0), 0);
+    else
+      vals.assign(ValIndex(time_vals, 0, 0, 0, 0), 0);
   
-  //reads in the primary scalar variable 
-  //the netCDF get method can only read in values to contigous blocks of memory, meaning we have to get values
-  //row by row.
-  for(int n = 0; n < time_vals; n++)
-    {
-      for(int k = 0; k < s_rho; k++)
-	{
-	  for(int j = 0; j < eta_rho; j++)
-	    {
-	      scalar_var->set_cur(n,k,j,0);
-	      scalar_var->get(&vals[n][k][j][0], 1, 1, 1, xi_rho);
-	      
-	    }
+    //reads in the scalar variables, a whole time step of one variable per netCDF call
+    chrono::steady_clock::time_point load_start = chrono::steady_clock::now();
+    for(int n = 0; n < time_vals; n++)
+      {
+	bool ok;
+	if(single_precision)
+	  ok = ReadTimeStep(scalar_vars, n, &vals_f[ValIndex(n, 0, 0, 0, 0)]);
+	else
+	  ok = ReadTimeStep(scalar_vars, n, &vals[ValIndex(n, 0, 0, 0, 0)]);
+	if(!ok){
+	  cout << "uSimROMS3: error reading time step " << n << " of the scalar variables" << endl;
+	  return false;
 	}
-    }    
-  cout << "uSimROMS3: field for \"" << varName << "\" populated" << endl;
+      }    
+    double load_secs = chrono::duration<double>(chrono::steady_clock::now() - load_start).count();
+    double load_mb = single_precision ? vals_f.size() * sizeof(float) / 1e6 : vals.size() * sizeof(double) / 1e6;
+    cout << "uSimROMS3: fields for " << NumVars() << " variable(s) populated, " << load_mb << " MB in " << load_secs
+	 << " s (" << load_mb / max(load_secs, 1e-6) << " MB/s)" << endl;
+  }
   
   //create maskRho array in local memory, read in maskRho values
-  maskRho = new int* [eta_rho];
-  for(int j = 0; j < eta_rho; j++)
-    maskRho[j] = new int[xi_rho];
-  
-  // read in row by row
-  for(int j = 0; j < eta_rho; j++) 
-    {
-      maskRho_var->set_cur(j,0);
-      maskRho_var->get(&maskRho[j][0], 1, xi_rho);
-    }
-
-  cout << "uSimROMS3: latitude field populated" << endl;
+  maskRho.assign(Cell(eta_rho, 0), 0);
+  if(!ReadGrid(maskRho_var, &maskRho[0], eta_rho, xi_rho)){
+    cout << "uSimROMS3: error reading mask_rho values" << endl;
+    return false;
+  }
+  cout << "uSimROMS3: mask field populated" << endl;
 
   //create lat array in local memory, read in lat values
-  lat = new double* [eta_rho];
-  for(int j = 0; j < eta_rho; j++)
-    lat[j] = new double[xi_rho];
-  
-  //just like the main variable, lon/lat need to be read in row by row
-  for(int j = 0; j < eta_rho; j++) 
-    {
-      lat_var->set_cur(j,0);
-      lat_var->get(&lat[j][0], 1, xi_rho);
-    }
-  
+  lat.assign(Cell(eta_rho, 0), 0);
+  if(!ReadGrid(lat_var, &lat[0], eta_rho, xi_rho)){
+    cout << "uSimROMS3: error reading latitude values" << endl;
+    return false;
+  }
   cout << "uSimROMS3: latitude field populated" << endl;
   
-  
-  
   //create lon array in local memory, read in lon values
-  lon = new double* [eta_rho];
-  for(int j = 0; j < eta_rho; j++)
-    lon[j] = new double[xi_rho];
-  
-  //also needs to be read in row by row
-  for(int j = 0; j < eta_rho; j++)
-    {
-      lon_var->set_cur(j,0);
-      lon_var->get(&lon[j][0], 1 , xi_rho);
-      }       
+  lon.assign(Cell(eta_rho, 0), 0);
+  if(!ReadGrid(lon_var, &lon[0], eta_rho, xi_rho)){
+    cout << "uSimROMS3: error reading longitude values" << endl;
+    return false;
+  }
   cout << "uSimROMS3: longitude field populated" << endl;
   
   //read in time values 
-  time = new double [time_vals]; 
+  time.assign(time_vals, 0); 
   time_var->get(&time[0], time_vals);
   cout << "uSimROMS3: time field populated" << endl;
   
@@ -191,22 +310,16 @@ bool USR_MOOSApp::ReadNcFile()
   }   
   
   //read in s_rho values
-  s_values = new double[s_rho];
+  s_values.assign(s_rho, 0);
   s_var->get(&s_values[0], s_rho);
   cout << "uSimROMS3: depth field populated" << endl;
   
-  //create bathy array in local memory, read in lat values
-  bathy  = new double* [eta_rho];
-  for(int j = 0; j < eta_rho; j++)
-    bathy[j] = new double[xi_rho];
-  
-  //needs to be read in row by row
-  for(int j = 0; j < eta_rho; j++) 
-    {
-      bathy_var->set_cur(j,0);
-      bathy_var->get(&bathy[j][0], 1, xi_rho);
-    }
-  
+  //create bathy array in local memory, read in bathy values
+  bathy.assign(Cell(eta_rho, 0), 0);
+  if(!ReadGrid(bathy_var, &bathy[0], eta_rho, xi_rho)){
+    cout << "uSimROMS3: error reading bathymetry values" << endl;
+    return false;
+  }
   cout << "uSimROMS3: bathymetry field populated" << endl;    
   return true;
   
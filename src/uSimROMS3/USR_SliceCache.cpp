@@ -0,0 +1,186 @@
+//---------------------------------------------------------------------
+// USR_SliceCache.cpp
+//
+// slices are shared_ptrs so a slice evicted while GetValue() is still
+// averaging over it stays alive until GetValue() lets go of it. a slice
+// still held by a caller is never picked for eviction, and slices being
+// read count against the capacity, so at most Capacity() slices are ever
+// in memory as long as callers only hold the two slices they interpolate
+// between.
+
+#include "USR_SliceCache.h"
+using namespace std;
+
+//---------------------------------------------------------------------
+// Constructor
+
+USR_SliceCache::USR_SliceCache()
+{
+  m_slice_size = 0;
+  m_capacity   = 2;
+  m_running    = false;
+  m_stop       = false;
+  m_tick       = 0;
+  m_misses     = 0;
+}
+
+//---------------------------------------------------------------------
+// Destructor
+
+USR_SliceCache::~USR_SliceCache()
+{
+  Stop();
+}
+
+//---------------------------------------------------------------------
+// Procedure: Start
+
+void USR_SliceCache::Start(Loader loader, size_t slice_size, int capacity)
+{
+  Stop();
+  m_loader     = loader;
+  m_slice_size = slice_size;
+  m_capacity   = (capacity < 2) ? 2 : capacity;
+  m_stop       = false;
+  m_running    = true;
+  m_thread     = thread(&USR_SliceCache::Run, this);
+}
+
+//---------------------------------------------------------------------
+// Procedure: Stop
+// notes: waits for a read in progress to finish, then drops every slice
+
+void USR_SliceCache::Stop()
+{
+  if(!m_running)
+    return;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+    m_requests.clear();
+  }
+  m_cv.notify_all();
+  m_thread.join();
+  m_slices.clear();
+  m_last_used.clear();
+  m_running = false;
+}
+
+//---------------------------------------------------------------------
+// Procedure: Get
+
+USR_SlicePtr USR_SliceCache::Get(int n)
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(m_loading.count(n))   // already on its way in from the prefetch thread
+    m_cv.wait(lock);
+
+  map<int, USR_SlicePtr>::iterator p = m_slices.find(n);
+  if(p != m_slices.end()){
+    m_last_used[n] = ++m_tick;
+    return(p->second);
+  }
+
+  m_misses++;
+  MakeRoom();  // if every slice is held we go over capacity rather than fail the read
+  return(Load(n, lock));
+}
+
+//---------------------------------------------------------------------
+// Procedure: Prefetch
+// notes: with only 2 slots the slice read ahead would push out one of the
+//        two the vehicle is using, so prefetching needs at least 3
+
+void USR_SliceCache::Prefetch(int n)
+{
+  if(m_capacity < 3)
+    return;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if(m_slices.count(n) || m_loading.count(n))
+      return;
+    for(unsigned int i = 0; i < m_requests.size(); i++)
+      if(m_requests[i] == n)
+	return;
+    m_requests.push_back(n);
+  }
+  m_cv.notify_all();
+}
+
+//---------------------------------------------------------------------
+// Procedure: MakeRoom
+// notes: evicts least recently used slices nobody else holds until there
+//        is a free slot. returns false if that isn't possible
+
+bool USR_SliceCache::MakeRoom()
+{
+  while((int)(m_slices.size() + m_loading.size()) >= m_capacity){
+    int victim = -1;
+    unsigned long oldest = 0;
+    map<int, USR_SlicePtr>::iterator p;
+    for(p = m_slices.begin(); p != m_slices.end(); p++){
+      if(p->second.use_count() > 1)
+	continue;
+      if(victim < 0 || m_last_used[p->first] < oldest){
+	victim = p->first;
+	oldest = m_last_used[p->first];
+      }
+    }
+    if(victim < 0)
+      return(false);
+    m_slices.erase(victim);
+    m_last_used.erase(victim);
+  }
+  return(true);
+}
+
+//---------------------------------------------------------------------
+// Procedure: Load
+// notes: called with m_mutex held, drops it while reading so Get() on
+//        other (resident) slices isn't blocked by the disk
+
+USR_SlicePtr USR_SliceCache::Load(int n, unique_lock<mutex> &lock)
+{
+  m_loading.insert(n);
+  lock.unlock();
+
+  shared_ptr<vector<double> > slice(new vector<double>(m_slice_size));
+  bool ok;
+  {
+    lock_guard<mutex> io(m_io_mutex);
+    ok = m_loader(n, &(*slice)[0]);
+  }
+
+  lock.lock();
+  m_loading.erase(n);
+  if(ok){
+    m_slices[n]    = slice;
+    m_last_used[n] = ++m_tick;
+  }
+  m_cv.notify_all();
+  return(ok ? USR_SlicePtr(slice) : USR_SlicePtr());
+}
+
+//---------------------------------------------------------------------
+// Procedure: Run
+// notes: prefetch thread, reads requested slices as long as there is a
+//        slot to put them in
+
+void USR_SliceCache::Run()
+{
+  unique_lock<mutex> lock(m_mutex);
+  while(true){
+    while(!m_stop && m_requests.empty())
+      m_cv.wait(lock);
+    if(m_stop)
+      break;
+
+    int n = m_requests.front();
+    m_requests.pop_front();
+    if(m_slices.count(n) || m_loading.count(n))
+      continue;
+    if(!MakeRoom())
+      continue;
+    Load(n, lock);
+  }
+}
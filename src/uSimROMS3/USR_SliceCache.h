@@ -0,0 +1,75 @@
+//---------------------------------------------------------------------
+// USR_SliceCache: holds a bounded number of time slices of the ROMS
+// field in memory when the whole variable is too big to load. slices are
+// read on demand through a loader function, and a background thread
+// reads ahead the slice the vehicle will need next so Iterate() doesn't
+// stall on the disk when REMUS time crosses into a new time step.
+// the key is whatever the loader makes of it, with TILE_FIELD each entry
+// is one horizontal tile of one time step instead of a whole slice.
+
+#ifndef USR_SLICECACHE_HEADER
+#define USR_SLICECACHE_HEADER
+
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+typedef std::shared_ptr<const std::vector<double> > USR_SlicePtr;
+
+class USR_SliceCache
+{
+public:
+  // fills dest (slice_size values) with time step n, returns false on error
+  typedef std::function<bool(int n, double* dest)> Loader;
+
+  USR_SliceCache();
+  ~USR_SliceCache();
+
+  // capacity is the most slices ever held at once, at least 2
+  void Start(Loader loader, size_t slice_size, int capacity);
+  void Stop();
+  bool IsRunning() const {return(m_running);}
+
+  // returns time step n, reading it now if it isn't resident. the slice
+  // stays valid for as long as the caller holds on to the pointer.
+  USR_SlicePtr Get(int n);
+
+  // asks the background thread to read time step n
+  void Prefetch(int n);
+
+  int    Capacity() const  {return(m_capacity);}
+  size_t SliceBytes() const {return(m_slice_size * sizeof(double));}
+  unsigned long Misses() const {return(m_misses);}
+
+protected:
+  void Run();
+  USR_SlicePtr Load(int n, std::unique_lock<std::mutex> &lock);
+  bool MakeRoom();
+
+protected:
+  Loader m_loader;
+  size_t m_slice_size;
+  int    m_capacity;
+  bool   m_running;
+  bool   m_stop;
+  unsigned long m_tick;
+  unsigned long m_misses;
+
+  std::mutex              m_mutex;    // guards everything below
+  std::mutex              m_io_mutex; // netCDF isn't thread safe, one read at a time
+  std::condition_variable m_cv;
+  std::thread             m_thread;
+
+  std::map<int, USR_SlicePtr>  m_slices;
+  std::map<int, unsigned long> m_last_used;
+  std::set<int>                m_loading;
+  std::deque<int>              m_requests;
+};
+
+#endif
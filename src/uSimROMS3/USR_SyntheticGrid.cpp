@@ -0,0 +1,22 @@
+//---------------------------------------------------------------------
+// USR_SyntheticGrid: see USR_SyntheticGrid.h
+
+#include <cmath>
+#include <cstddef>
+#include "USR_SyntheticGrid.h"
+
+//---------------------------------------------------------------------
+// Procedure: USR_SyntheticGrid
+
+void USR_SyntheticGrid(int eta, int xi, double* north, double* east)
+{
+  double rot = 0.35;
+  for(int j = 0; j < eta; j++){
+    for(int i = 0; i < xi; i++){
+      double u = 200.0 * i;
+      double v = 200.0 * j + 1500.0 * sin(i / 150.0);
+      east[size_t(j) * xi + i] = u * cos(rot) - v * sin(rot);
+      north[size_t(j) * xi + i] = u * sin(rot) + v * cos(rot);
+    }
+  }
+}
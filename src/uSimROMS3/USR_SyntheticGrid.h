@@ -0,0 +1,13 @@
+//---------------------------------------------------------------------
+// USR_SyntheticGrid: the synthetic curvilinear grid the benchmarks run
+// on, so they time the same grid without needing a ROMS file.
+
+#ifndef USR_SYNTHETICGRID_HEADER
+#define USR_SYNTHETICGRID_HEADER
+
+// fills north/east, flat (eta, xi) arrays indexed j*xi + i, with the
+// local meters of a rotated, gently bending grid with ~200 m spacing,
+// similar to a coastal ROMS domain
+void USR_SyntheticGrid(int eta, int xi, double* north, double* east);
+
+#endif
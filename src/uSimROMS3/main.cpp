@@ -31,6 +31,9 @@ int main(int argc ,char * argv[])
 {
   string mission_file;
   string run_command = argv[0];
+  string batch_in, batch_out;
+  int    batch_threads = 0;
+  bool   serve = false;
 
   for(int i=1; i<argc; i++) {
     string argi = argv[i];
@@ -46,6 +49,14 @@ int main(int argc ,char * argv[])
       mission_file = argv[i];
     else if(strBegins(argi, "--alias="))
       run_command = argi.substr(8);
+    else if(argi == "--serve")
+      serve = true;
+    else if(strBegins(argi, "--batch="))
+      batch_in = argi.substr(8);
+    else if(strBegins(argi, "--out="))
+      batch_out = argi.substr(6);
+    else if(strBegins(argi, "--threads="))
+      batch_threads = atoi(argi.substr(10).c_str());
     else if(i==2)
       run_command = argi;
   }
@@ -53,6 +64,19 @@ int main(int argc ,char * argv[])
   if(mission_file == "")
     showHelpAndExit();
 
+  //offline sampling along a file of points or serving a shared field, no MOOSDB needed
+  string app_name = (run_command == argv[0]) ? "uSimROMS3" : run_command;
+  if(serve){
+    USR_MOOSApp server;
+    return(server.RunServer(mission_file, app_name) ? 0 : 1);
+  }
+  if(batch_in != ""){
+    if(batch_out == "")
+      batch_out = batch_in + ".sampled.csv";
+    USR_MOOSApp sampler;
+    return(sampler.RunBatch(mission_file, app_name, batch_in, batch_out, batch_threads) ? 0 : 1);
+  }
+
   cout << termColor("green");
   cout << "new uSimROMS3 launching as " << run_command << endl;
   cout << termColor() << endl;